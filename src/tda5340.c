@@ -21,145 +21,82 @@ THE SOFTWARE.
 */
 
 #include <assert.h>
-
-#include <xmc_eru.h>
-#include <xmc_gpio.h>
-#include <xmc_spi.h>
+#include <string.h>
 
 #include "tda5340.h"
 #include "util.h"
 #include <bitbuffer.h>
 
-/* pin config */
-#if UC_SERIES == XMC11
-	/* for csmTDA */
-	#define TDAPON  P0_5 /* P_ON */
-	#define TDANINT P2_6 /* PP2 <-> ERU0.2A1 */
-
-	/* spi pins, usic 1, channel 1 */
-	#define SPI_ALT XMC_GPIO_MODE_OUTPUT_PUSH_PULL_ALT6
-	#define SPI_MISO P0_15 /* SDO, DX0D */
-	#define SPI_INPUTSRC USIC0_C0_DX0_P0_15
-	#define SPI_MOSI P0_14 /* SDI, DOUT0 */
-	#define SPI_SS   P0_9 /* NCS, SELO0 */
-	#define SPI_SCLK P0_8 /* SCLK, SCLKOUT */
-
-	/* ETL config */
-	#define ETL ERU0_ETL2
-	#define ETL_SRCAB XMC_ERU_ETL_SOURCE_A
-	#define ETL_SRCPIN .input_a = ERU0_ETL2_INPUTA_P2_6
-#elif UC_SERIES == XMC45
-	/* We cannot use P1.14 or P1.15 here. These are used for the buttons. Yes, I
-	 * tried that. */
-	#define TDAPON  P0_3 /* P_ON */
-	#define TDANINT P0_2 /* PP2 <-> ERU0.3B3, that is ERU0, channel 3, input B, signal 3 */
-
-	/* spi pins, usic 1, channel 1 */
-	#define SPI_ALT XMC_GPIO_MODE_OUTPUT_PUSH_PULL_ALT2
-	#define SPI_MISO P0_0 /* SDO, DX0D */
-	#define SPI_INPUTSRC USIC1_C1_DX0_P0_0
-	#define SPI_MOSI P0_1 /* SDI, DOUT0 */
-	#define SPI_SS   P0_9 /* NCS, SELO0 */
-	#define SPI_SCLK P0_10 /* SCLK, SCLKOUT */
-
-	/* ETL config */
-	#define ETL ERU0_ETL3
-	#define ETL_SRCAB XMC_ERU_ETL_SOURCE_B
-	#define ETL_SRCPIN .input_b = ERU0_ETL3_INPUTB_P0_2
+#define debug(f, ...) halDebug("tda: " f, ##__VA_ARGS__)
+
+/* constant spi channel, retry policy and callbacks with TDA_STATIC_CONFIG,
+ * the compiler can then inline the bus access and drop unused events */
+#if defined(TDA_STATIC_CONFIG)
+#define ctxSpi(ctx) (TDA_STATIC_SPI)
+#define ctxRetries(ctx) (TDA_STATIC_RETRIES)
+#define callback(ctx, name, NAME) callbackOf (TDA_STATIC_##NAME)
+#ifndef TDA_STATIC_TXERROR
+#define TDA_STATIC_TXERROR txerror
+#endif
+#ifndef TDA_STATIC_TXREADY
+#define TDA_STATIC_TXREADY NULL
+#endif
+#ifndef TDA_STATIC_TXAE
+#define TDA_STATIC_TXAE NULL
+#endif
+#ifndef TDA_STATIC_TXEMPTY
+#define TDA_STATIC_TXEMPTY NULL
+#endif
+#ifndef TDA_STATIC_RXFSYNC
+#define TDA_STATIC_RXFSYNC NULL
+#endif
+#ifndef TDA_STATIC_RXEOM
+#define TDA_STATIC_RXEOM NULL
+#endif
+#ifndef TDA_STATIC_RXAF
+#define TDA_STATIC_RXAF NULL
+#endif
+#ifndef TDA_STATIC_RXFSYNCB
+#define TDA_STATIC_RXFSYNCB NULL
+#endif
+#ifndef TDA_STATIC_RXEOMB
+#define TDA_STATIC_RXEOMB NULL
+#endif
 #else
-	#error "unknown uc"
+#define ctxSpi(ctx) ((ctx)->spi)
+#define ctxRetries(ctx) ((ctx)->retries)
+#define callback(ctx, name, NAME) ((ctx)->name)
 #endif
 
-/* common */
-/* interrupt, depends on OGU used, make sure you change TDA5350IRQHANDLER in .h
- * too */
-#define INTERRUPT ERU0_3_IRQn
-/* select trigger channel */
-#define ETL_CHANNEL XMC_ERU_ETL_OUTPUT_TRIGGER_CHANNEL3
-/* OGU */
-#define OGU ERU0_OGU3
+/*	Identity, keeps NULL checks of constant callbacks free of warnings
+ */
+static inline tda5340Callback callbackOf (const tda5340Callback cb) {
+	return cb;
+}
 
-#include <SEGGER_RTT.h>
-//#define debug(...)
-#define debug(f, ...) SEGGER_RTT_printf(0, "tda: " f, ##__VA_ARGS__)
+/* binary tracing for hot paths, debug() is too slow there */
+#ifdef TDA_TRACE
+#define trace(ctx, type, a, b) do { \
+	if ((ctx)->trace != NULL) { \
+		tda5340TraceRecord ((ctx)->trace, \
+				(ctx)->clock != NULL ? (ctx)->clock () : 0, type, a, b); \
+	} \
+} while (0)
+#else
+#define trace(ctx, type, a, b) do { (void) (a); (void) (b); } while (0)
+#endif
 
 static void spiInit (tda5340Ctx * const ctx) {
 	assert (ctx != NULL);
-	/* 5m works fine, 10m does not */
-	assert (ctx->baudrate > 0 && ctx->baudrate < 10000000);
-	XMC_SPI_CH_CONFIG_t config = {
-		.baudrate = ctx->baudrate,
-		.bus_mode = XMC_SPI_CH_BUS_MODE_MASTER,
-		.selo_inversion = XMC_SPI_CH_SLAVE_SEL_INV_TO_MSLS, /* low-active */
-		.parity_mode = XMC_USIC_CH_PARITY_MODE_NONE
-		};
-	XMC_USIC_CH_t * const spi = ctx->spi;
-
-	const XMC_GPIO_CONFIG_t configAlt = { .mode = SPI_ALT };
-	const XMC_GPIO_CONFIG_t configTri = { .mode = XMC_GPIO_MODE_INPUT_TRISTATE };
-	XMC_GPIO_Init (SPI_MOSI, &configAlt);
-	XMC_GPIO_Init (SPI_SS, &configAlt);
-	XMC_GPIO_Init (SPI_SCLK, &configAlt);
-	XMC_GPIO_Init (SPI_MISO, &configTri);
-
-	/* init spi */
-	XMC_SPI_CH_Init(spi, &config);
-
-	XMC_SPI_CH_SetInputSource(spi, XMC_USIC_CH_INPUT_DX0, SPI_INPUTSRC);
-	XMC_SPI_CH_SetBitOrderMsbFirst (spi);
-	/* the clock must be shifted by half a period, so data on MOSI is set on
-	 * falling edge. The TDA samples its signal on the rising edge */
-	XMC_USIC_CH_ConfigureShiftClockOutput (spi,
-			XMC_USIC_CH_BRG_SHIFT_CLOCK_PASSIVE_LEVEL_0_DELAY_ENABLED,
-			XMC_USIC_CH_BRG_SHIFT_CLOCK_OUTPUT_SCLK);
-#if 0
-	XMC_USIC_CH_DisableInputInversion (XMC_SPI1_CH0, XMC_USIC_CH_INPUT_DX0);
-#endif
+	/* 5m works fine on the reference board, 10m does not. Use
+	 * tda5340SpiTune to find the limit of others */
+	assert (ctx->baudrate > 0);
 
-	XMC_SPI_CH_Start(spi);
+	halSpiInit (ctxSpi (ctx), ctx->baudrate);
 
 	debug ("initialized spi\n");
 }
 
-/*	Initialize PON pin
- */
-static void ponInit (tda5340Ctx * const ctx) {
-	const XMC_GPIO_CONFIG_t config = {
-			.mode = XMC_GPIO_MODE_OUTPUT_PUSH_PULL,
-			.output_level = XMC_GPIO_OUTPUT_LEVEL_LOW,
-			};
-	XMC_GPIO_Init (TDAPON, &config);
-}
-
-/*	Initialize NINT pin and interrupt handler
- */
-static void nintInit (tda5340Ctx * const ctx, const uint32_t priority) {
-	const XMC_GPIO_CONFIG_t config = {
-			.mode = XMC_GPIO_MODE_INPUT_TRISTATE,
-			};
-	XMC_GPIO_Init (TDANINT, &config);
-
-	static const XMC_ERU_ETL_CONFIG_t etlCfg = {
-		/* XXX: is is _very_ important that you use .input_a OR .input_b here
-		 * and NOT (BY ALL FUCKING MEANS NOT!) .input */
-		ETL_SRCPIN,
-		.source = ETL_SRCAB,
-		.edge_detection = XMC_ERU_ETL_EDGE_DETECTION_FALLING,
-		.status_flag_mode = XMC_ERU_ETL_STATUS_FLAG_MODE_HWCTRL,
-		.enable_output_trigger = true,
-		/* trigger ogu x */
-		.output_trigger_channel = ETL_CHANNEL,
-		};
-	static const XMC_ERU_OGU_CONFIG_t oguCfg = {
-		.service_request = XMC_ERU_OGU_SERVICE_REQUEST_ON_TRIGGER
-		};
-	XMC_ERU_ETL_Init(ETL, &etlCfg);
-	XMC_ERU_OGU_Init(OGU, &oguCfg);
-
-	NVIC_SetPriority(INTERRUPT, priority);
-	NVIC_EnableIRQ(INTERRUPT);
-}
-
 static void txerror (tda5340Ctx * const ctx, void * const data) {
 	assert (0);
 }
@@ -170,20 +107,42 @@ static void ctxReset (tda5340Ctx * const ctx) {
 	ctx->mode = TDA_RESET_MODE;
 	ctx->page = 0;
 	ctx->lock = 0;
+	ctx->txhead = 0;
+	ctx->txcount = 0;
+	ctx->txactive = false;
+	ctx->txscheduled = false;
+	if (ctx->timer) {
+		/* no stale TXC write after reset */
+		halTimerStop (ctxSpi (ctx));
+	}
+	ctx->adc = NULL;
+	ctx->polled = false;
+	/* all interrupts are enabled after reset */
+	memset (ctx->im, 0, sizeof (ctx->im));
 }
 
-/*	Initialize TDA handle
+/*	Initialize TDA handle. The scheduling timer is only claimed by the first
+ *	tda5340TransmissionSchedule.
  *
- *	:param priority: priority for NINT interrupt, encoded with NVIC_EncodePriority()
+ *	:param priority: priority for NINT and scheduling timer interrupt, encoded
+ *	with NVIC_EncodePriority()
  */
 void tda5340Init (tda5340Ctx * const ctx, const uint32_t priority) {
 	spiInit (ctx);
-	ponInit (ctx);
-	nintInit (ctx, priority);
+	halPonInit (ctxSpi (ctx));
+	halNintInit (ctxSpi (ctx), priority);
 
+	ctx->priority = priority;
+	ctx->timer = false;
+	ctx->irqDepth = 0;
+	osMutexInit (&ctx->bus);
 	ctxReset (ctx);
 	/* defaults to standard handler */
 	ctx->txerror = txerror;
+	/* the timebase is opt-in, see tda5340_time.h */
+	if (ctx->clock == NULL && tda5340TimeRunning ()) {
+		ctx->clock = tda5340TimeNow;
+	}
 
 	debug ("init complete\n");
 }
@@ -195,49 +154,44 @@ void tda5340Init (tda5340Ctx * const ctx, const uint32_t priority) {
  */
 void tda5340Reset (tda5340Ctx * const ctx) {
 	ctxReset (ctx);
-	XMC_GPIO_SetOutputLow (TDAPON);
-	delayus (500);
-	XMC_GPIO_SetOutputHigh (TDAPON);
+	halPonSet (ctxSpi (ctx), false);
+	/* once at startup, before any interrupt or timer is set up */
+	halDelayus (500);
+	halPonSet (ctxSpi (ctx), true);
 }
 
-/*	Write one byte to the SPI bus, blocking.
+/*	Power TDA off by keeping P_ON low, tda5340Reset powers it up again. All
+ *	register contents are lost, see tda5340SnapshotCapture.
  */
-static uint16_t spiByte (XMC_USIC_CH_t * const spi, const uint8_t write) {
-	const uint32_t recvFlag = XMC_SPI_CH_STATUS_FLAG_RECEIVE_INDICATION |
-				XMC_SPI_CH_STATUS_FLAG_ALTERNATIVE_RECEIVE_INDICATION;
-	XMC_SPI_CH_ClearStatusFlag (spi, recvFlag);
-
-	XMC_SPI_CH_Transmit(spi, write, XMC_SPI_CH_MODE_STANDARD);
-
-	while ((XMC_SPI_CH_GetStatusFlag(spi) & (recvFlag)) == 0U);
-
-	/* the value must be read otherwise the buffer is going to overrun and new
-	 * data is not stored anymore */
-	return XMC_SPI_CH_GetReceivedData (spi);
+void tda5340PowerOff (tda5340Ctx * const ctx) {
+	ctxReset (ctx);
+	halPonSet (ctxSpi (ctx), false);
 }
 
-/*	Basic register read, SS signal unchanged
+/*	Basic register read, SS signal unchanged. Failed transfers read 0.
  */
-static uint8_t regReadNoSS (XMC_USIC_CH_t * const spi, const tda5340Address reg) {
-	spiByte (spi, TDA_RD);
-	spiByte (spi, reg & 0xff);
-	return spiByte (spi, 0x00);
+static uint8_t regReadNoSS (tda5340HalSpi * const spi, const tda5340Address reg) {
+	const uint8_t tx[] = {TDA_RD, reg & 0xff, 0x00};
+	uint8_t rx[arraysize (tx)];
+	halSpiTransfer (spi, tx, rx, arraysize (tx));
+	return rx[2];
 }
 
 /*	Write a TDA register, no slave select signal changed
  */
-static void regWriteNoSS (XMC_USIC_CH_t * const spi, const tda5340Address reg,
+static bool regWriteNoSS (tda5340HalSpi * const spi, const tda5340Address reg,
 		const uint8_t val) {
-	spiByte (spi, TDA_WR);
-	spiByte (spi, reg & 0xff);
-	spiByte (spi, val);
+	const uint8_t tx[] = {TDA_WR, reg & 0xff, val};
+	return halSpiTransfer (spi, tx, NULL, arraysize (tx));
 }
 
 /*	Write and verify most recent register write
  */
-static bool regWriteVerifyNoSS (XMC_USIC_CH_t * const spi, const tda5340Address reg,
+static bool regWriteVerifyNoSS (tda5340HalSpi * const spi, const tda5340Address reg,
 		const uint8_t val) {
-	regWriteNoSS (spi, reg, val);
+	if (!regWriteNoSS (spi, reg, val)) {
+		return false;
+	}
 	/* page change never required here */
 	const uint8_t lastAddress = regReadNoSS (spi, TDA_SPIAT);
 	const uint8_t lastData = regReadNoSS (spi, TDA_SPIDT);
@@ -254,46 +208,77 @@ static uint8_t addressToPage (const tda5340Address address) {
  */
 static bool pageChangeNoSS (tda5340Ctx * const ctx, const tda5340Address reg) {
 	/*	Check whether the current page needs to be changed before accessing the
-	 *	address; registers above 0xa0 are mirrored on all pages */
+	 *	address; registers above 0xa0 are mirrored on all pages, see
+	 *	tda5340RegMeta */
 	const uint8_t page = addressToPage (reg);
 	bool ret = true;
-	if ((reg & 0xff) < 0xa0 && ctx->page != page) {
-		ret = regWriteVerifyNoSS (ctx->spi, TDA_SFRPAGE, page);
+	if (!(tda5340RegFlags (reg) & TDA_REG_MIRROR) && ctx->page != page) {
+		ret = regWriteVerifyNoSS (ctxSpi (ctx), TDA_SFRPAGE, page);
 		ctx->page = page;
 	}
 	return ret;
 }
 
-/* 	Atomic SPI transaction start/end primitives
+/*	Keep tda5340IrqHandle out, nests. Masks NINT and, in thread context,
+ *	holds the recursive driver mutex, which the interrupt handler takes as
+ *	well on ports without interrupt context (pthreads).
  */
-static void spiStart (tda5340Ctx * const ctx) {
-	/* isr uses spi as well and should not interrupt this */
-	NVIC_DisableIRQ(INTERRUPT);
-#if UC_SERIES == XMC11
-	/* μc lacks atomic compare & swap */
-	__disable_irq ();
-	assert (ctx->lock == 0 && "busy");
-	ctx->lock = 1;
-	__enable_irq ();
-#elif UC_SERIES == XMC45
-	assert (__sync_bool_compare_and_swap (&ctx->lock, 0, 1) && "busy");
-#endif
-	XMC_SPI_CH_EnableSlaveSelect(ctx->spi, XMC_SPI_CH_SLAVE_SELECT_0);
+static void irqLock (tda5340Ctx * const ctx) {
+	/* other threads wait for the driver instead of running into the lock */
+	if (osInThread ()) {
+		osMutexLock (&ctx->bus);
+	}
+	if (ctx->irqDepth++ == 0) {
+		halNintDisable (ctxSpi (ctx));
+	}
+}
+
+static void irqUnlock (tda5340Ctx * const ctx) {
+	assert (ctx->irqDepth > 0);
+	if (--ctx->irqDepth == 0 && !ctx->polled) {
+		halNintEnable (ctxSpi (ctx));
+	}
+	if (osInThread ()) {
+		osMutexUnlock (&ctx->bus);
+	}
+}
+
+/* 	Atomic SPI transaction start/end primitives, cmd and address are for
+ * 	tracing only
+ */
+static void spiStart (tda5340Ctx * const ctx, const uint8_t cmd,
+		const uint16_t address) {
+	/* isrs use spi as well and should not interrupt this */
+	irqLock (ctx);
+	if (ctx->timer) {
+		halTimerDisable (ctxSpi (ctx));
+	}
+	const bool locked = halLock (&ctx->lock);
+	assert (locked && "busy");
+	(void) locked;
+	trace (ctx, TDA_TRACE_SPI_BEGIN, cmd, address);
+	halSsEnable (ctxSpi (ctx));
 }
 
 static void spiEnd (tda5340Ctx * const ctx) {
-	XMC_SPI_CH_DisableSlaveSelect (ctx->spi);
+	halSsDisable (ctxSpi (ctx));
+	trace (ctx, TDA_TRACE_SPI_END, 0, 0);
 	ctx->lock = 0;
-	NVIC_EnableIRQ(INTERRUPT);
+	if (ctx->timer) {
+		halTimerEnable (ctxSpi (ctx));
+	}
+	irqUnlock (ctx);
 }
 
 /*	Read from TDA register. The read is not interruptible, so interrupt handler
  *	callbacks can safely use this function.
  */
 uint8_t tda5340RegRead (tda5340Ctx * const ctx, const tda5340Address reg) {
-	spiStart (ctx);
+	assert (tda5340RegFlags (reg) & TDA_REG_READ);
+
+	spiStart (ctx, TDA_RD, reg);
 	pageChangeNoSS (ctx, reg);
-	const uint16_t ret = regReadNoSS (ctx->spi, reg);
+	const uint16_t ret = regReadNoSS (ctxSpi (ctx), reg);
 	spiEnd (ctx);
 
 	return ret;
@@ -303,11 +288,15 @@ uint8_t tda5340RegRead (tda5340Ctx * const ctx, const tda5340Address reg) {
  */
 static bool regWritePageVerifyNoSS (tda5340Ctx * const ctx,
 		const tda5340Address reg, const uint8_t val) {
+	assert (tda5340RegFlags (reg) & TDA_REG_WRITE);
+
 	pageChangeNoSS (ctx, reg);
 
 	bool success = false;
-	uint8_t retries = ctx->retries;
-	while (!(success = regWriteVerifyNoSS (ctx->spi, reg, val)) && retries-- > 0);
+	uint8_t retries = ctxRetries (ctx);
+	while (!(success = regWriteVerifyNoSS (ctxSpi (ctx), reg, val)) && retries-- > 0) {
+		trace (ctx, TDA_TRACE_RETRY, retries, reg);
+	}
 	return success;
 }
 
@@ -315,7 +304,7 @@ static bool regWritePageVerifyNoSS (tda5340Ctx * const ctx,
  */
 bool tda5340RegWrite (tda5340Ctx * const ctx, const tda5340Address reg,
 		const uint8_t val) {
-	spiStart (ctx);
+	spiStart (ctx, TDA_WR, reg);
 	const bool ret = regWritePageVerifyNoSS (ctx, reg, val);
 	spiEnd (ctx);
 
@@ -329,7 +318,7 @@ bool tda5340RegWriteBulk (tda5340Ctx * const ctx, const tdaConfigVal * const cfg
 		size_t count) {
 	bool ret = true;
 
-	spiStart (ctx);
+	spiStart (ctx, TDA_WR, count > 0 ? cfg[0].reg : 0);
 	for (size_t i = 0; i < count; i++) {
 		ret = regWritePageVerifyNoSS (ctx, cfg[i].reg, cfg[i].val);
 		if (!ret) {
@@ -341,17 +330,146 @@ bool tda5340RegWriteBulk (tda5340Ctx * const ctx, const tdaConfigVal * const cfg
 	return ret;
 }
 
+/*	Look up the value reg is set to by cfg, the last entry wins. Returns false
+ *	if reg is not part of cfg.
+ */
+static bool configLookup (const tdaConfigVal * const cfg, const size_t count,
+		const tda5340Address reg, uint8_t * const val) {
+	for (size_t i = count; i > 0; i--) {
+		if (cfg[i-1].reg == reg) {
+			*val = cfg[i-1].val;
+			return true;
+		}
+	}
+	return false;
+}
+
+/*	Switch from configuration from (i.e. the one loaded last) to to, writing
+ *	only registers that are not set to the same value already. Volatile
+ *	registers are always written. Same restrictions as tda5340RegWriteBulk.
+ */
+bool tda5340RegWriteDiff (tda5340Ctx * const ctx, const tdaConfigVal * const from,
+		const size_t fromCount, const tdaConfigVal * const to,
+		const size_t toCount) {
+	assert (ctx != NULL);
+	assert (from != NULL || fromCount == 0);
+	assert (to != NULL);
+
+	bool ret = true;
+
+	spiStart (ctx, TDA_WR, toCount > 0 ? to[0].reg : 0);
+	for (size_t i = 0; i < toCount; i++) {
+		const tdaConfigVal * const c = &to[i];
+		uint8_t old;
+		if (!(tda5340RegFlags (c->reg) & TDA_REG_VOLATILE) &&
+				configLookup (from, fromCount, c->reg, &old) && old == c->val) {
+			continue;
+		}
+		ret = regWritePageVerifyNoSS (ctx, c->reg, c->val);
+		if (!ret) {
+			break;
+		}
+	}
+	spiEnd (ctx);
+
+	return ret;
+}
+
 /* start with default value reset, then set all bits in `set` and clear those
  * in `clear`
  * XXX: should be used everywhere!
  */
 #define fromReset(reset,set,clear) (((reset) | (set)) & ~(clear))
 
-bool tda5340ModeSet (tda5340Ctx * const ctx, const uint8_t mode, const bool sendbit,
+/*	CMC register value for mode and config
+ */
+static uint8_t cmcValue (const uint8_t mode, const uint8_t config) {
+	/* the cmc register is write-only, so we can’t just read the old stuff, add
+	 * our new mode and write back again; instead always enable the brown out
+	 * detector and hope for the best */
+	return (mode << TDA_CMC_MSEL_OFF) | (config << TDA_CMC_MCS_OFF) |
+			(1 << TDA_CMC_ENBOD_OFF);
+}
+
+/*	Program interrupt masks for mode, so only events someone handles pull
+ *	NINT. Bits set in IMx mask an interrupt source. Called by tda5340ModeSet,
+ *	call it again after changing callbacks.
+ */
+bool tda5340IrqMaskUpdate (tda5340Ctx * const ctx, const uint8_t mode) {
+	assert (ctx != NULL);
+
+	/* IM1 covers configs C and D, which are never enabled */
+	uint8_t im[3] = {0xff, 0xff, 0xff};
+
+	switch (mode) {
+		case TDA_TRANSMIT_MODE:
+			/* error handler is always set and transmit queue depends on
+			 * almost empty and ready */
+			im[2] &= ~(1 << TDA_IM2_TXERROR_OFF |
+					1 << TDA_IM2_TXAE_OFF |
+					1 << TDA_IM2_TXREADY_OFF);
+			if (callback (ctx, txempty, TXEMPTY) != NULL) {
+				im[2] &= ~(1 << TDA_IM2_TXEMPTY_OFF);
+			}
+			break;
+
+		case TDA_RUN_MODE_SLAVE:
+		case TDA_SELF_POLLING_MODE:
+			if (callback (ctx, rxfsync, RXFSYNC) != NULL || ctx->fsyncTime) {
+				im[0] &= ~(1 << TDA_IM0_FSYNCA_OFF | 1 << TDA_IM0_FSYNCB_OFF);
+			}
+			if (callback (ctx, rxeom, RXEOM) != NULL) {
+				im[0] &= ~(1 << TDA_IM0_EOMA_OFF | 1 << TDA_IM0_EOMB_OFF);
+			}
+			if (callback (ctx, rxfsyncb, RXFSYNCB) != NULL) {
+				im[0] &= ~(1 << TDA_IM0_FSYNCB_OFF);
+			}
+			if (callback (ctx, rxeomb, RXEOMB) != NULL) {
+				im[0] &= ~(1 << TDA_IM0_EOMB_OFF);
+			}
+			if (callback (ctx, rxaf, RXAF) != NULL) {
+				im[2] &= ~(1 << TDA_IM2_RXAF_OFF);
+			}
+			break;
+
+		default:
+			/* nothing is handled in sleep mode */
+			break;
+	}
+
+	static const tda5340Address reg[] = {TDA_IM0, TDA_IM1, TDA_IM2};
+	for (uint8_t i = 0; i < arraysize (reg); i++) {
+		if (im[i] == ctx->im[i]) {
+			continue;
+		}
+		if (!tda5340RegWrite (ctx, reg[i], im[i])) {
+			return false;
+		}
+		ctx->im[i] = im[i];
+	}
+	return true;
+}
+
+/*	Count delivered and filtered events of status register with mask. The
+ *	status is only read on NINT, filtered events that happen alone are not
+ *	seen.
+ */
+static void irqAccount (tda5340Ctx * const ctx, const uint8_t status,
+		const uint8_t mask) {
+	ctx->irqDelivered += __builtin_popcount (status & ~mask);
+	ctx->irqFiltered += __builtin_popcount (status & mask);
+}
+
+static bool modeSet (tda5340Ctx * const ctx, const uint8_t mode, const bool sendbit,
 		const uint8_t config) {
 	/* two bits */
 	assert (config < 4);
 
+	/* before switching, so no unwanted event slips through */
+	if (!tda5340IrqMaskUpdate (ctx, mode)) {
+		return false;
+	}
+
 	switch (mode) {
 		case TDA_TRANSMIT_MODE:
 			if (!tda5340RegWrite (ctx, TDA_TXC,
@@ -370,6 +488,14 @@ bool tda5340ModeSet (tda5340Ctx * const ctx, const uint8_t mode, const bool send
 				return false;
 			}
 			ctx->sendbit = sendbit;
+			/* fifo is empty now, drop everything queued */
+			ctx->txhead = 0;
+			ctx->txcount = 0;
+			ctx->txactive = false;
+			if (ctx->txfifoAel != 0 && !tda5340RegWrite (ctx, TDA_TXFIFOAEL,
+					ctx->txfifoAel)) {
+				return false;
+			}
 			break;
 
 		case TDA_RUN_MODE_SLAVE: {
@@ -390,84 +516,655 @@ bool tda5340ModeSet (tda5340Ctx * const ctx, const uint8_t mode, const bool send
 			break;
 	}
 
-	/* the cmc register is write-only, so we can’t just read the old stuff, add
-	 * our new mode and write back again; instead always enable the brown out
-	 * detector and hope for the best */
-	if (!tda5340RegWrite (ctx, TDA_CMC, (mode << TDA_CMC_MSEL_OFF) |
-			(config << TDA_CMC_MCS_OFF) |
-			(1 << TDA_CMC_ENBOD_OFF))) {
+	if (!tda5340RegWrite (ctx, TDA_CMC, cmcValue (mode, config))) {
 		return false;
 	}
 	ctx->mode = mode;
+	trace (ctx, TDA_TRACE_MODE, mode, config);
 
 	return true;
 }
 
-/*	Start a transmission in SBF mode
+/*	Switch mode, the interrupt handler sees either the old or the new mode
+ *	and transmit queue
  */
-bool tda5340TransmissionStart (tda5340Ctx * const ctx) {
-	return tda5340RegWrite (ctx, TDA_TXC,
-			(1 << TDA_TXC_TXENDFIFO_OFF) |
+bool tda5340ModeSet (tda5340Ctx * const ctx, const uint8_t mode, const bool sendbit,
+		const uint8_t config) {
+	irqLock (ctx);
+	const bool ret = modeSet (ctx, mode, sendbit, config);
+	irqUnlock (ctx);
+	return ret;
+}
+
+static uint8_t txcStart (const tda5340Ctx * const ctx) {
+	return (1 << TDA_TXC_TXENDFIFO_OFF) |
 			(ctx->sendbit ? 1 : 0) << TDA_TXC_TXMODE_OFF |
 			/* enable failsafe mode */
 			(1 << TDA_TXC_TXFAILSAFE_OFF) |
 			/* not sure if relevant, but enabled by tda explorer */
 			(1 << TDA_TXC_TXBDRSYNC_OFF) |
 			/* actually start transmission */
-			(1 << TDA_TXC_TXSTART_OFF)
-			);
+			(1 << TDA_TXC_TXSTART_OFF);
+}
+
+/*	Start a transmission in SBF mode
+ */
+bool tda5340TransmissionStart (tda5340Ctx * const ctx) {
+	return tda5340RegWrite (ctx, TDA_TXC, txcStart (ctx));
+}
+
+/* the timer is armed this early and the handler spins for the rest, covers
+ * interrupt latency and timer rounding */
+#define SCHEDULE_SPIN 50
+
+static void scheduleArm (tda5340Ctx * const ctx, const uint32_t remaining) {
+	halTimerArm (ctxSpi (ctx), remaining > SCHEDULE_SPIN ?
+			remaining - SCHEDULE_SPIN : 0);
 }
 
-/*	Write packet to transmission fifo
+/*	Start transmission at timestamp at (see ctx->clock), for slotted access.
+ *	The frame must be in the fifo already, see tda5340FifoWrite. The TXC
+ *	write is prepared now and sent by tda5340TimerHandle, without verifying
+ *	it first. Slots can be aligned to a beacon using ctx->rxfsyncTime, which
+ *	is only taken with ctx->fsyncTime set or an rxfsync callback.
+ *
+ *	Returns false if at is in the past.
  */
-void tda5340FifoWrite (tda5340Ctx * const ctx, const uint8_t * const data, const size_t bits) {
+bool tda5340TransmissionSchedule (tda5340Ctx * const ctx, const uint32_t at) {
+	assert (ctx != NULL && ctx->clock != NULL);
 	assert (ctx->mode == TDA_TRANSMIT_MODE);
-	assert (data != NULL);
-	assert (bits > 0 && bits <= 256);
+	assert (!ctx->txscheduled);
+	/* mirrored, no page change required when firing */
+	assert (tda5340RegFlags (TDA_TXC) & TDA_REG_MIRROR);
+
+	const int32_t remaining = at - ctx->clock ();
+	if (remaining <= 0) {
+		return false;
+	}
+
+	ctx->txstaged[0] = TDA_WR;
+	ctx->txstaged[1] = TDA_TXC & 0xff;
+	ctx->txstaged[2] = txcStart (ctx);
+	ctx->txat = at;
+	if (!ctx->timer) {
+		halTimerInit (ctxSpi (ctx), ctx->priority);
+		ctx->timer = true;
+	}
+	ctx->txscheduled = true;
+	scheduleArm (ctx, remaining);
 
-	const size_t bytes = (bits-1)/8 + 1;
-	XMC_USIC_CH_t * const spi = ctx->spi;
+	return true;
+}
 
-	spiStart (ctx);
+/*	Scheduling timer handler, call from TDA5340TIMERHANDLER
+ */
+void tda5340TimerHandle (tda5340Ctx * const ctx) {
+	assert (ctx != NULL);
 
-	spiByte (spi, TDA_WRF);
-	spiByte (spi, bits-1);
-	/* actual data is lsb first */
-	XMC_SPI_CH_SetBitOrderLsbFirst (spi);
-	for (unsigned char i = 0; i < bytes; i++) {
-		spiByte (spi, data[i]);
+	halTimerAck (ctxSpi (ctx));
+	if (!ctx->txscheduled) {
+		return;
 	}
+
+	const int32_t remaining = ctx->txat - ctx->clock ();
+	if (remaining > SCHEDULE_SPIN) {
+		/* beyond the timer’s range */
+		scheduleArm (ctx, remaining);
+		return;
+	}
+	while ((int32_t) (ctx->txat - ctx->clock ()) > 0);
+
+	spiStart (ctx, TDA_WR, TDA_TXC);
+	const bool sent = halSpiTransfer (ctxSpi (ctx), ctx->txstaged, NULL,
+			arraysize (ctx->txstaged));
+	ctx->txStartTime = ctx->clock ();
+	if (remaining < 0) {
+		/* the handler ran past the slot, not just the spin */
+		const uint32_t late = ctx->txStartTime - ctx->txat;
+		ctx->txLateStarts++;
+		if (late > ctx->txLateMax) {
+			ctx->txLateMax = late;
+		}
+	}
+	/* verify after the fact, the slot is missed anyway if it failed */
+	bool success = sent &&
+			regReadNoSS (ctxSpi (ctx), TDA_SPIAT) == ctx->txstaged[1] &&
+			regReadNoSS (ctxSpi (ctx), TDA_SPIDT) == ctx->txstaged[2];
+	if (!success) {
+		trace (ctx, TDA_TRACE_RETRY, ctxRetries (ctx), TDA_TXC);
+		success = regWritePageVerifyNoSS (ctx, TDA_TXC, ctx->txstaged[2]);
+	}
+	spiEnd (ctx);
+
+	ctx->txscheduled = false;
+	ctx->txactive = success;
+	if (!success && callback (ctx, txerror, TXERROR) != NULL) {
+		callback (ctx, txerror, TXERROR) (ctx, ctx->data);
+	}
+}
+
+/*	Append packet to transmission fifo, slave select signal unchanged
+ */
+static bool fifoWriteNoSS (tda5340HalSpi * const spi, const uint8_t * const data,
+		const size_t bits) {
+	const uint8_t header[] = {TDA_WRF, bits-1};
+
+	bool ok = halSpiTransfer (spi, header, NULL, arraysize (header));
+	/* actual data is lsb first */
+	halSpiBitOrder (spi, true);
+	ok = ok && halSpiTransfer (spi, data, NULL, (bits-1)/8 + 1);
 	/* switch back */
-	XMC_SPI_CH_SetBitOrderMsbFirst (spi);
+	halSpiBitOrder (spi, false);
+	return ok;
+}
+
+/*	Write packet to transmission fifo. Returns false if the transfer failed
+ *	or the packet is empty or larger than the fifo (TDA_TXFIFO_SIZE bits).
+ */
+bool tda5340FifoWrite (tda5340Ctx * const ctx, const uint8_t * const data, const size_t bits) {
+	assert (ctx->mode == TDA_TRANSMIT_MODE);
+	assert (data != NULL);
+
+	if (bits == 0 || bits > TDA_TXFIFO_SIZE) {
+		return false;
+	}
 
+	spiStart (ctx, TDA_WRF, bits);
+	const bool ret = fifoWriteNoSS (ctxSpi (ctx), data, bits);
 	spiEnd (ctx);
+	return ret;
 }
 
-/*	Read data from receive fifo. Returns false if fifo overflow occured.
+/*	Move the oldest queued frame into the fifo, isr only. A frame lost to a
+ *	failed transfer is reported as transmission error.
  */
-bool tda5340FifoRead (tda5340Ctx * const ctx, uint32_t * const retData,
-		uint8_t * const retSize) {
-	XMC_USIC_CH_t * const spi = ctx->spi;
-	uint32_t data = 0;
+static bool txQueueDrain (tda5340Ctx * const ctx) {
+	assert (ctx->txcount > 0);
+
+	tda5340TxFrame * const f = &ctx->txqueue[ctx->txhead];
+	const bool ret = tda5340FifoWrite (ctx, f->data, f->bits);
+	ctx->txhead = (ctx->txhead + 1) % TDA_TXQUEUE_LEN;
+	--ctx->txcount;
+	if (!ret && callback (ctx, txerror, TXERROR) != NULL) {
+		callback (ctx, txerror, TXERROR) (ctx, ctx->data);
+	}
+	return ret;
+}
 
-	spiStart (ctx);
+/*	Queue packet for transmission. If the transmitter is idle the packet is
+ *	written and sent immediately, otherwise it is appended to the fifo by the
+ *	isr as soon as the almost-empty watermark is reached, so back-to-back
+ *	frames are sent without leaving transmit mode. The TDA does not delimit
+ *	them, the bits follow the previous frame directly on air, so every packet
+ *	must be a complete frame with its own preamble and sync word (see
+ *	tda5340Frame.header) and receivers must end frames by length to catch the
+ *	next sync word. Returns false if the queue is full, a scheduled start is
+ *	pending (tda5340TimerHandle owns that start) or the packet does not fit
+ *	into the fifo space available at the watermark, TDA_TXFIFO_SIZE minus the
+ *	almost-empty level.
+ */
+bool tda5340TxQueuePush (tda5340Ctx * const ctx, const uint8_t * const data,
+		const size_t bits) {
+	assert (ctx != NULL);
+	assert (data != NULL);
 
-	spiByte (spi, TDA_RDF);
-	/* the actual data is lsb first */
-	XMC_SPI_CH_SetBitOrderLsbFirst (spi);
-	for (unsigned char i = 0; i < 4*8; i += 8) {
-		data |= spiByte (spi, 0x00) << i;
+	if (bits == 0 || bits > (size_t) (TDA_TXFIFO_SIZE - ctx->txfifoAel)) {
+		return false;
+	}
+
+	irqLock (ctx);
+	assert (ctx->mode == TDA_TRANSMIT_MODE);
+	bool ret = false;
+	if (ctx->txscheduled) {
+		/* starting now would defeat the slot alignment */
+	} else if (!ctx->txactive) {
+		/* the isr does not touch the queue while the transmitter is idle */
+		assert (ctx->txcount == 0);
+		ctx->txactive = tda5340FifoWrite (ctx, data, bits) &&
+				tda5340TransmissionStart (ctx);
+		ret = ctx->txactive;
+	} else if (ctx->txcount < TDA_TXQUEUE_LEN) {
+		const uint8_t tail = (ctx->txhead + ctx->txcount) % TDA_TXQUEUE_LEN;
+		tda5340TxFrame * const f = &ctx->txqueue[tail];
+		memcpy (f->data, data, (bits-1)/8 + 1);
+		f->bits = bits;
+		++ctx->txcount;
+		ret = true;
+	}
+	irqUnlock (ctx);
+
+	return ret;
+}
+
+/* snapshot cursor positions: mirrored registers 0xa0…0xff first, then 0x00…0x9f
+ * of every page */
+#define SNAPSHOT_CURSOR_MIRRORED 0x60
+#define SNAPSHOT_CURSOR_END (SNAPSHOT_CURSOR_MIRRORED + 4*0xa0)
+
+/*	Translate snapshot cursor to register address
+ */
+static tda5340Address snapshotAddress (const uint16_t cursor) {
+	if (cursor < SNAPSHOT_CURSOR_MIRRORED) {
+		return 0xa0 + cursor;
+	}
+	const uint16_t i = cursor - SNAPSHOT_CURSOR_MIRRORED;
+	return ((i / 0xa0) << 8) | (i % 0xa0);
+}
+
+/*	Advance cursor to the next configuration register (including cursor
+ *	itself). Returns false at the end.
+ */
+static bool snapshotNext (uint16_t * const cursor) {
+	for (; *cursor < SNAPSHOT_CURSOR_END; ++*cursor) {
+		if (tda5340RegFlags (snapshotAddress (*cursor)) & TDA_REG_CONFIG) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*	Fletcher-16 update
+ */
+static void fletcher16 (uint16_t * const sum1, uint16_t * const sum2,
+		const uint8_t val) {
+	*sum1 = (*sum1 + val) % 255;
+	*sum2 = (*sum2 + *sum1) % 255;
+}
+
+/*	Read all configuration registers into snap. Blocking. Returns false if a
+ *	page change failed, snap is incomplete then.
+ */
+bool tda5340SnapshotCapture (tda5340Ctx * const ctx, tda5340Snapshot * const snap) {
+	assert (ctx != NULL);
+	assert (snap != NULL);
+
+	uint16_t sum1 = 0, sum2 = 0, pos = 0;
+	bool ret = true;
+
+	spiStart (ctx, TDA_RD, 0);
+	for (uint16_t cursor = 0; snapshotNext (&cursor) && ret; ++cursor) {
+		const tda5340Address reg = snapshotAddress (cursor);
+		assert (pos < TDA_SNAPSHOT_SIZE);
+		ret = pageChangeNoSS (ctx, reg);
+		snap->val[pos] = regReadNoSS (ctxSpi (ctx), reg);
+		fletcher16 (&sum1, &sum2, snap->val[pos]);
+		++pos;
+	}
+	spiEnd (ctx);
+	if (!ret) {
+		return false;
+	}
+	assert (pos == TDA_SNAPSHOT_SIZE);
+
+	snap->checksum = (sum2 << 8) | sum1;
+	return true;
+}
+
+/*	Prepare restoring snap, budget registers are handled per step.
+ */
+void tda5340RestoreInit (tda5340Restore * const r, const tda5340Snapshot * const snap,
+		const uint16_t budget) {
+	assert (r != NULL);
+	assert (snap != NULL);
+	assert (budget > 0);
+
+	r->snap = snap;
+	r->budget = budget;
+	r->duration = 0;
+	r->cursor = 0;
+	r->pos = 0;
+	r->verify = false;
+	r->sum1 = 0;
+	r->sum2 = 0;
+}
+
+/*	Restore a snapshot after power-up, the TDA must be in sleep mode. Each call
+ *	handles up to budget registers and returns TDA_RESTORE_PENDING until done,
+ *	so it can be interleaved with other work. Registers are written page by
+ *	page without individual verification; a second pass reads them back and
+ *	compares the checksum, which is cheaper than verifying every write.
+ */
+tda5340RestoreStatus tda5340RestoreStep (tda5340Ctx * const ctx,
+		tda5340Restore * const r) {
+	assert (ctx != NULL);
+	assert (r != NULL);
+	assert (ctx->mode == TDA_SLEEP_MODE);
+
+	const tda5340Snapshot * const snap = r->snap;
+	tda5340HalSpi * const spi = ctxSpi (ctx);
+
+	if (r->cursor == 0 && r->pos == 0 && !r->verify) {
+		/* do not write garbage */
+		uint16_t sum1 = 0, sum2 = 0;
+		for (uint16_t i = 0; i < TDA_SNAPSHOT_SIZE; i++) {
+			fletcher16 (&sum1, &sum2, snap->val[i]);
+		}
+		if (snap->checksum != ((sum2 << 8) | sum1)) {
+			return TDA_RESTORE_CORRUPT;
+		}
+		r->start = ctx->clock != NULL ? ctx->clock () : 0;
+	}
+
+	bool ret = true;
+	spiStart (ctx, r->verify ? TDA_RD : TDA_WR, snapshotAddress (r->cursor));
+	for (uint16_t n = 0; n < r->budget && snapshotNext (&r->cursor) && ret;
+			n++, r->cursor++, r->pos++) {
+		const tda5340Address reg = snapshotAddress (r->cursor);
+		ret = pageChangeNoSS (ctx, reg);
+		if (!r->verify) {
+			ret = ret && regWriteNoSS (spi, reg, snap->val[r->pos]);
+			if (reg >= TDA_IM0 && reg <= TDA_IM2) {
+				ctx->im[reg - TDA_IM0] = snap->val[r->pos];
+			}
+		} else {
+			fletcher16 (&r->sum1, &r->sum2, regReadNoSS (spi, reg));
+		}
+	}
+	spiEnd (ctx);
+
+	if (!ret) {
+		return TDA_RESTORE_ERROR;
+	}
+	if (r->pos < TDA_SNAPSHOT_SIZE) {
+		return TDA_RESTORE_PENDING;
+	}
+	if (!r->verify) {
+		/* start read back */
+		r->verify = true;
+		r->cursor = 0;
+		r->pos = 0;
+		return TDA_RESTORE_PENDING;
+	}
+
+	if (ctx->clock != NULL) {
+		r->duration = ctx->clock () - r->start;
+	}
+	return snap->checksum == ((r->sum2 << 8) | r->sum1) ?
+			TDA_RESTORE_DONE : TDA_RESTORE_CORRUPT;
+}
+
+/*	Set telegram start identifier of config, so configs A and B can receive
+ *	different sync words in self polling mode. The TDA must be in sleep mode.
+ */
+bool tda5340TsiSet (tda5340Ctx * const ctx, const uint8_t config,
+		const tda5340Tsi * const tsi) {
+	assert (ctx != NULL);
+	assert (ctx->mode == TDA_SLEEP_MODE);
+	assert (config < 4);
+	assert (tsi != NULL);
+	assert (tsi->lenA <= 16 && tsi->lenB <= 16);
+
+	const tdaConfigVal cfg[] = {
+			{tdaConfigAddress (config, TDA_A_TSIMODE), tsi->mode},
+			{tdaConfigAddress (config, TDA_A_TSILENA), tsi->lenA},
+			{tdaConfigAddress (config, TDA_A_TSILENB), tsi->lenB},
+			{tdaConfigAddress (config, TDA_A_TSIGAP), tsi->gap},
+			{tdaConfigAddress (config, TDA_A_TSIPTA0), tsi->patternA & 0xff},
+			{tdaConfigAddress (config, TDA_A_TSIPTA1), tsi->patternA >> 8},
+			{tdaConfigAddress (config, TDA_A_TSIPTB0), tsi->patternB & 0xff},
+			{tdaConfigAddress (config, TDA_A_TSIPTB1), tsi->patternB >> 8},
+			};
+	return tda5340RegWriteBulk (ctx, cfg, arraysize (cfg));
+}
+
+/*	Program up to four PLL channel slots and the tx channel offset of config
+ *	once, so tda5340Hop can switch between them with a single register write.
+ *	The TDA must be in sleep mode.
+ */
+bool tda5340HopSetup (tda5340Ctx * const ctx, const uint8_t config,
+		const tda5340Channel * const channels, const uint8_t count,
+		const uint16_t offset) {
+	assert (ctx != NULL);
+	assert (ctx->mode == TDA_SLEEP_MODE);
+	assert (config < 4);
+	assert (channels != NULL);
+	assert (count > 0 && count <= TDA_PLL_CHANNELS);
+
+	/* four registers per slot plus offset */
+	tdaConfigVal cfg[TDA_PLL_CHANNELS*4+2];
+	size_t n = 0;
+	for (uint8_t i = 0; i < count; i++) {
+		/* slots are four registers apart */
+		const tda5340Address base = tdaConfigAddress (config, TDA_A_PLLINTC1) + i*4;
+		const uint32_t frac = channels[i].pllfrac;
+		cfg[n++] = (tdaConfigVal) {base, channels[i].pllint};
+		cfg[n++] = (tdaConfigVal) {base+1, frac & 0xff};
+		cfg[n++] = (tdaConfigVal) {base+2, (frac >> 8) & 0xff};
+		cfg[n++] = (tdaConfigVal) {base+3, (frac >> 16) & 0xff};
+	}
+	cfg[n++] = (tdaConfigVal) {tdaConfigAddress (config, TDA_A_TXCHOFFS0), offset & 0xff};
+	cfg[n++] = (tdaConfigVal) {tdaConfigAddress (config, TDA_A_TXCHOFFS1), offset >> 8};
+
+	return tda5340RegWriteBulk (ctx, cfg, n);
+}
+
+/*	Switch transmitter to PLL channel slot (0…3) programmed by
+ *	tda5340HopSetup. TXCHNL is mirrored on all pages, so this is exactly one
+ *	(verified) register write. The duration is stored in hopLatency.
+ */
+bool tda5340Hop (tda5340Ctx * const ctx, const uint8_t channel) {
+	assert (ctx != NULL);
+	assert (channel < TDA_PLL_CHANNELS);
+
+	const uint32_t start = ctx->clock != NULL ? ctx->clock () : 0;
+	const bool ret = tda5340RegWrite (ctx, TDA_TXCHNL,
+			(channel & TDA_TXCHNL_PLLCH_MSK) << TDA_TXCHNL_PLLCH_OFF);
+	if (ctx->clock != NULL) {
+		ctx->hopLatency = ctx->clock () - start;
 	}
+	return ret;
+}
+
+/*	Set transmit power level (TXPOWER0) of config
+ */
+bool tda5340TxPowerSet (tda5340Ctx * const ctx, const uint8_t config,
+		const uint8_t power) {
+	assert (config < 4);
+	return tda5340RegWrite (ctx, tdaConfigAddress (config, TDA_A_TXPOWER0), power);
+}
+
+/*	First RSSI sample deadline, interval μs from now, see sampleWait
+ */
+static uint32_t sampleStart (const uint32_t interval) {
+	return tda5340TimeRunning () ? tda5340TimeNow () + interval : 0;
+}
+
+/*	Wait for the RSSI sample at *due and advance it by interval. With the
+ *	timebase running, bus transactions and interrupts served in between do
+ *	not stretch the sampling period, without it this is a plain delay.
+ */
+static void sampleWait (uint32_t * const due, const uint32_t interval) {
+	if (!tda5340TimeRunning ()) {
+		halDelayus (interval);
+		return;
+	}
+	/* more than a period late (long interrupt), do not catch up with a burst
+	 * of samples */
+	const uint32_t now = tda5340TimeNow ();
+	if ((int32_t) (now - *due) > (int32_t) interval) {
+		*due = now;
+	}
+	while (!tda5340TimeReached (*due));
+	*due += interval;
+}
+
+/*	Survey channel occupancy. Every channel of scan is loaded into PLL slot C1
+ *	of config (overwriting it), the receiver is restarted and RSSIRX sampled
+ *	dwell times. Only PLL registers that differ from the previous channel are
+ *	written, so a retune costs at most four register writes plus CMC. The bus
+ *	is held for the retune and every sample only, interrupts are served in
+ *	between. The TDA is left in receive mode.
+ */
+bool tda5340ScanRun (tda5340Ctx * const ctx, const uint8_t config,
+		tda5340Scan * const scan) {
+	assert (ctx != NULL);
+	assert (config < 4);
+	assert (scan != NULL);
+	assert (scan->channels != NULL && scan->count > 0);
+	assert (scan->histogram != NULL && scan->bins > 0);
+	assert (scan->dwell > 0);
+
+	memset (scan->histogram, 0, scan->count*scan->bins);
+
+	if (!tda5340ModeSet (ctx, TDA_RUN_MODE_SLAVE, false, config)) {
+		return false;
+	}
+
+	const uint32_t start = ctx->clock != NULL ? ctx->clock () : 0;
+	tda5340HalSpi * const spi = ctxSpi (ctx);
+	const tda5340Address base = tdaConfigAddress (config, TDA_A_PLLINTC1);
+	/* force full write for the first channel */
+	uint8_t prev[4] = {0, 0, 0, 0};
+	bool first = true;
+	bool ret = true;
+
+	for (uint8_t c = 0; c < scan->count && ret; c++) {
+		const tda5340Channel * const ch = &scan->channels[c];
+		const uint8_t next[4] = {ch->pllint, ch->pllfrac & 0xff,
+				(ch->pllfrac >> 8) & 0xff, (ch->pllfrac >> 16) & 0xff};
+		spiStart (ctx, TDA_WR, base);
+		for (uint8_t i = 0; i < arraysize (next) && ret; i++) {
+			if (first || next[i] != prev[i]) {
+				ret = regWritePageVerifyNoSS (ctx, base+i, next[i]);
+			}
+		}
+		memcpy (prev, next, sizeof (prev));
+		first = false;
+
+		/* restart receiver on the new frequency */
+		ret = ret && regWriteVerifyNoSS (spi, TDA_CMC,
+				cmcValue (TDA_RUN_MODE_SLAVE, config));
+		spiEnd (ctx);
+
+		uint8_t * const hist = &scan->histogram[c*scan->bins];
+		uint32_t due = sampleStart (scan->interval);
+		for (uint8_t i = 0; i < scan->dwell && ret; i++) {
+			sampleWait (&due, scan->interval);
+			spiStart (ctx, TDA_RD, TDA_RSSIRX);
+			const uint8_t rssi = regReadNoSS (spi, TDA_RSSIRX);
+			spiEnd (ctx);
+			const uint8_t bin = (rssi * scan->bins) >> 8;
+			if (hist[bin] < UINT8_MAX) {
+				++hist[bin];
+			}
+		}
+	}
+
+	if (ctx->clock != NULL) {
+		scan->duration = ctx->clock () - start;
+	}
+
+	return ret;
+}
+
+/*	Set crystal calibration, XTALCAL0 holds the low byte
+ */
+bool tda5340XtalCalSet (tda5340Ctx * const ctx, const uint16_t xtalcal) {
+	assert (ctx != NULL);
+
+	const tdaConfigVal cfg[] = {
+			{TDA_XTALCAL0, xtalcal & 0xff},
+			{TDA_XTALCAL1, xtalcal >> 8},
+			};
+	return tda5340RegWriteBulk (ctx, cfg, arraysize (cfg));
+}
+
+/*	Feed AFCOFFSET of the frame just received into afc and apply a new
+ *	crystal calibration if required. Costs a single register read per frame,
+ *	so it can be called from the rxeom callback.
+ */
+bool tda5340AfcUpdate (tda5340Ctx * const ctx, tda5340Afc * const afc) {
+	assert (ctx != NULL);
+	assert (afc != NULL);
+
+	const int8_t offset = tda5340RegRead (ctx, TDA_AFCOFFSET);
+	if (tda5340AfcFeed (afc, offset)) {
+		return tda5340XtalCalSet (ctx, afc->xtalcal);
+	}
+	return true;
+}
+
+/*	Listen before talk: receive on rxconfig, sample RSSIRX every interval μs
+ *	until cca (configured once with tda5340CcaInit, restarted by every call)
+ *	decides and transmit data on txconfig right away if the channel is clear.
+ *	The TDA is left in receive mode if the channel is busy.
+ */
+tda5340CcaStatus tda5340Lbt (tda5340Ctx * const ctx, const uint8_t rxconfig,
+		const uint8_t txconfig, const uint8_t * const data, const size_t bits,
+		tda5340Cca * const cca, const uint32_t interval) {
+	assert (ctx != NULL);
+	assert (cca != NULL);
+
+	tda5340CcaInit (cca, cca->samples, cca->threshold);
+	if (!tda5340ModeSet (ctx, TDA_RUN_MODE_SLAVE, false, rxconfig)) {
+		return TDA_CCA_ERROR;
+	}
+
+	/* RSSIRX is mirrored, so every sample is a single read without page
+	 * change. The bus is free while waiting, interrupts are served. */
+	tda5340HalSpi * const spi = ctxSpi (ctx);
+	tda5340CcaStatus status;
+	uint32_t due = sampleStart (interval);
+	do {
+		sampleWait (&due, interval);
+		spiStart (ctx, TDA_RD, TDA_RSSIRX);
+		const uint8_t rssi = regReadNoSS (spi, TDA_RSSIRX);
+		spiEnd (ctx);
+		status = tda5340CcaFeed (cca, rssi);
+	} while (status == TDA_CCA_PENDING);
+
+	if (status != TDA_CCA_CLEAR) {
+		return status;
+	}
+
+	const uint32_t start = ctx->clock != NULL ? ctx->clock () : 0;
+	if (!tda5340ModeSet (ctx, TDA_TRANSMIT_MODE, ctx->sendbit, txconfig) ||
+			!tda5340TxQueuePush (ctx, data, bits)) {
+		return TDA_CCA_ERROR;
+	}
+	if (ctx->clock != NULL) {
+		ctx->lbtLatency = ctx->clock () - start;
+	}
+	return TDA_CCA_CLEAR;
+}
+
+/*	One RDF transaction, slave select unchanged: four data bytes and the
+ *	number of valid bits. Returns false if the transfer failed.
+ */
+static bool fifoReadNoSS (tda5340HalSpi * const spi, uint8_t * const rx,
+		uint8_t * const bitsValid) {
+	static const uint8_t cmd = TDA_RDF;
+	bool ok = halSpiTransfer (spi, &cmd, NULL, 1);
+	/* the actual data is lsb first */
+	halSpiBitOrder (spi, true);
+	ok = halSpiTransfer (spi, NULL, rx, 4) && ok;
 	/* … and the valid bits switches back */
-	XMC_SPI_CH_SetBitOrderMsbFirst (spi);
-	const uint8_t bitsValid = spiByte (spi, 0x00);
+	halSpiBitOrder (spi, false);
+	return halSpiTransfer (spi, NULL, bitsValid, 1) && ok;
+}
+
+/*	Read data from receive fifo. Returns false if fifo overflow occured or the
+ *	transfer failed.
+ */
+bool tda5340FifoRead (tda5340Ctx * const ctx, uint32_t * const retData,
+		uint8_t * const retSize) {
+	tda5340HalSpi * const spi = ctxSpi (ctx);
+	uint8_t rx[4], bitsValid;
+
+	spiStart (ctx, TDA_RDF, 0);
+	const bool ok = fifoReadNoSS (spi, rx, &bitsValid);
+	const uint32_t data = rx[0] | rx[1] << 8 | rx[2] << 16 | (uint32_t) rx[3] << 24;
 
 	/*Disable Slave Select line */
 	spiEnd (ctx);
 
+	if (!ok) {
+		return false;
+	}
 	/* bits 5:0 indicate number of valid bits, bit 7 indicates fifo overflow
 	 * (i.e. some data was lost), see p. 46 */
 	if (bitsValid >> 7) {
+		trace (ctx, TDA_TRACE_OVERFLOW, 0, 0);
 		return false;
 	}
 	*retData = data;
@@ -507,41 +1204,77 @@ tda5340FifoReadStatus tda5340FifoReadAll (tda5340Ctx * const ctx, uint8_t * cons
 	return TDA_FIFO_OK;
 }
 
+/*	Drain the receive fifo into bb, slave select unchanged. Returns false on
+ *	overflow, failed transfers or if bb is full.
+ */
+static inline bool fifoDrainNoSS (tda5340HalSpi * const spi, bitbuffer * const bb) {
+	while (true) {
+		uint8_t rx[4], bitsValid;
+		if (!fifoReadNoSS (spi, rx, &bitsValid) || bitsValid >> 7) {
+			return false;
+		}
+		const uint8_t bits = bitsValid & 0x3f;
+		if (bits == 0) {
+			return true;
+		}
+		const uint32_t data = rx[0] | rx[1] << 8 | rx[2] << 16 |
+				(uint32_t) rx[3] << 24;
+		if (!bitbufferPush32 (bb, data, bits)) {
+			return false;
+		}
+	}
+}
+
+/*	Write ANTSW without verification, slave select unchanged
+ */
+static void antennaSwitchNoSS (tda5340Ctx * const ctx,
+		tda5340Diversity * const div, const uint8_t antenna) {
+	regWriteNoSS (ctxSpi (ctx), TDA_ANTSW, div->antsw[antenna]);
+	div->antenna = antenna;
+	div->switches++;
+}
+
 /*	Interrupt handler, calls the appropriate callbacks */
 void tda5340IrqHandle (tda5340Ctx * const ctx) {
 	assert (ctx != NULL);
 
+	irqLock (ctx);
+	/* status registers read, for tracing */
+	uint16_t status = 0;
+	const uint32_t now = ctx->clock != NULL ? ctx->clock () : 0;
+	ctx->nintTime = now;
+	trace (ctx, TDA_TRACE_IRQ_ENTER, ctx->mode, 0);
+
 	switch (ctx->mode) {
 		case TDA_RESET_MODE:
 			/* wait until NINT has been pulled low. triggering on falling edge,
 			 * thus check if flag is set */
-			if (XMC_ERU_ETL_GetStatusFlag (ETL)) {
+			if (halNintFlag (ctxSpi (ctx))) {
 				const uint8_t is0 = tda5340RegRead (ctx, TDA_IS0),
 						is1 = tda5340RegRead (ctx, TDA_IS1),
 						is2 = tda5340RegRead (ctx, TDA_IS2);
 				if (is0 != POR_MAGIC_STATUS || is1 != POR_MAGIC_STATUS ||
 						is2 != POR_MAGIC_STATUS) {
 					/* something is wrong, try again */
-					debug ("reset failed, regs are %x %x %x, trying again\n",
-							is0, is1, is2);
+					trace (ctx, TDA_TRACE_RESET_FAIL, is2, is0 << 8 | is1);
 					tda5340Reset (ctx);
 					break;
 				}
 
 				/* wait until TDA pulled NINT high after reading the status
 				 * register. flag is cleared by hardware on positive edge */
-				while (XMC_ERU_ETL_GetStatusFlag (ETL));
+				while (halNintFlag (ctxSpi (ctx)));
 
-				debug ("the interrupt seems to be working\n");
+				/* the interrupt seems to be working */
 
 				const uint8_t is2b = tda5340RegRead (ctx, TDA_IS2);
 				if (is2b != 0x00) {
-					debug ("reset failed, is2 is %x\n", is2b);
+					trace (ctx, TDA_TRACE_RESET_FAIL, is2b, 0);
 					tda5340Reset (ctx);
 					break;
 				}
 
-				debug ("and the register is back to normal\n");
+				/* and the register is back to normal */
 
 				ctx->mode = TDA_SLEEP_MODE;
 			}
@@ -556,23 +1289,42 @@ void tda5340IrqHandle (tda5340Ctx * const ctx) {
 			const uint8_t is2 = tda5340RegRead (ctx, TDA_IS2);
 			if (is2 == 0xff) {
 				/* XXX: check the others, it might be a reset interrupt? */
+				trace (ctx, TDA_TRACE_PHISHY, 0, 0);
 				break;
 			}
-			if (bitIsSet (is2, TDA_IS2_TXE_OFF) && ctx->txerror != NULL) {
+			status = is2;
+			irqAccount (ctx, is2, ctx->im[2]);
+			if (bitIsSet (is2, TDA_IS2_TXE_OFF) &&
+					callback (ctx, txerror, TXERROR) != NULL) {
 				/* transmission error */
-				ctx->txerror (ctx, ctx->data);
+				callback (ctx, txerror, TXERROR) (ctx, ctx->data);
 			}
-			if (bitIsSet (is2, TDA_IS2_TXAE_OFF) && ctx->txae != NULL) {
-				/* transmission fifo almost empty */
-				ctx->txae (ctx, ctx->data);
+			if (bitIsSet (is2, TDA_IS2_TXAE_OFF)) {
+				/* transmission fifo almost empty, chain next frame, which
+				 * brings its own preamble and sync word */
+				if (ctx->txactive && ctx->txcount > 0) {
+					txQueueDrain (ctx);
+				}
+				if (callback (ctx, txae, TXAE) != NULL) {
+					callback (ctx, txae, TXAE) (ctx, ctx->data);
+				}
 			}
-			if (bitIsSet (is2, TDA_IS2_TXEMPTY_OFF) && ctx->txempty != NULL) {
+			if (bitIsSet (is2, TDA_IS2_TXEMPTY_OFF) &&
+					callback (ctx, txempty, TXEMPTY) != NULL) {
 				/* transmission fifo empty */
-				ctx->txempty (ctx, ctx->data);
+				callback (ctx, txempty, TXEMPTY) (ctx, ctx->data);
 			}
-			if (bitIsSet (is2, TDA_IS2_TXR_OFF) && ctx->txready != NULL) {
-				/* tx ready */
-				ctx->txready (ctx, ctx->data);
+			if (bitIsSet (is2, TDA_IS2_TXR_OFF)) {
+				/* tx ready, the fifo ran empty before the next frame could be
+				 * appended; restart with whatever is queued */
+				ctx->txactive = false;
+				if (ctx->txcount > 0) {
+					ctx->txactive = txQueueDrain (ctx) &&
+							tda5340TransmissionStart (ctx);
+				}
+				if (callback (ctx, txready, TXREADY) != NULL) {
+					callback (ctx, txready, TXREADY) (ctx, ctx->data);
+				}
 			}
 			break;
 		}
@@ -580,37 +1332,69 @@ void tda5340IrqHandle (tda5340Ctx * const ctx) {
 		/* receive modes */
 		case TDA_RUN_MODE_SLAVE:
 		case TDA_SELF_POLLING_MODE: {
-			/* XXX: config b/c/d? */
+			/* configs C/D are never enabled, see tda5340IrqMaskUpdate */
 			const uint8_t is0 = tda5340RegRead (ctx, TDA_IS0);
 			//const uint8_t is1 = tda5340RegRead (ctx, TDA_IS1);
-			const uint8_t is2 = tda5340RegRead (ctx, TDA_IS2);
-			if (is0 == 0xff/* && is1 == 0xff*/ && is2 == 0xff) {
+			/* IS2 only carries rxaf in receive mode, save the read if it is
+			 * masked */
+			const bool readIs2 = !bitIsSet (ctx->im[2], TDA_IM2_RXAF_OFF);
+			const uint8_t is2 = readIs2 ? tda5340RegRead (ctx, TDA_IS2) : 0x00;
+			if (is0 == 0xff/* && is1 == 0xff*/ && (!readIs2 || is2 == 0xff)) {
 				/* XXX: something looks phishy */
-				debug ("phishy status\n");
+				trace (ctx, TDA_TRACE_PHISHY, 0, 0);
 				break;
 			}
+			status = is0 << 8 | is2;
+			irqAccount (ctx, is0, ctx->im[0]);
+			irqAccount (ctx, is2, ctx->im[2]);
+			if (bitIsSet (is0, TDA_IS0_FSYNCA_OFF) ||
+					bitIsSet (is0, TDA_IS0_FSYNCB_OFF)) {
+				ctx->rxfsyncTime = now;
+			}
+			if (bitIsSet (is0, TDA_IS0_EOMA_OFF) ||
+					bitIsSet (is0, TDA_IS0_EOMB_OFF)) {
+				ctx->rxeomTime = now;
+			}
 			/* order matters, if all events are received at the same time, the
 			 * “natural” order (frame start, rx full, end of message) should be
 			 * chosen */
-			if (bitIsSet (is0, TDA_IS0_FSYNCA_OFF) && ctx->rxfsync != NULL) {
+			if (bitIsSet (is0, TDA_IS0_FSYNCA_OFF) &&
+					callback (ctx, rxfsync, RXFSYNC) != NULL) {
 				/* frame synchronized config A */
-				ctx->rxfsync (ctx, ctx->data);
+				ctx->rxconfig = TDA_CONFIG_A;
+				callback (ctx, rxfsync, RXFSYNC) (ctx, ctx->data);
 			}
-			if (bitIsSet (is0, TDA_IS0_FSYNCB_OFF) && ctx->rxfsync != NULL) {
+			if (bitIsSet (is0, TDA_IS0_FSYNCB_OFF)) {
 				/* frame synchronized config B */
-				ctx->rxfsync (ctx, ctx->data);
+				const tda5340Callback cb =
+						callback (ctx, rxfsyncb, RXFSYNCB) != NULL ?
+						callback (ctx, rxfsyncb, RXFSYNCB) : callback (ctx, rxfsync, RXFSYNC);
+				if (cb != NULL) {
+					ctx->rxconfig = TDA_CONFIG_B;
+					cb (ctx, ctx->data);
+				}
 			}
-			if (bitIsSet (is2, TDA_IS2_RXAF_OFF) && ctx->rxaf != NULL) {
-				/* receive fifo almost full */
-				ctx->rxaf (ctx, ctx->data);
+			if (bitIsSet (is2, TDA_IS2_RXAF_OFF) &&
+					callback (ctx, rxaf, RXAF) != NULL) {
+				/* receive fifo almost full, rxconfig is the last config
+				 * synchronized */
+				callback (ctx, rxaf, RXAF) (ctx, ctx->data);
 			}
-			if (bitIsSet (is0, TDA_IS0_EOMA_OFF) && ctx->rxeom != NULL) {
+			if (bitIsSet (is0, TDA_IS0_EOMA_OFF) &&
+					callback (ctx, rxeom, RXEOM) != NULL) {
 				/* end of message indicator */
-				ctx->rxeom (ctx, ctx->data);
+				ctx->rxconfig = TDA_CONFIG_A;
+				callback (ctx, rxeom, RXEOM) (ctx, ctx->data);
 			}
-			if (bitIsSet (is0, TDA_IS0_EOMB_OFF) && ctx->rxeom != NULL) {
-				/* end of message indicator */
-				ctx->rxeom (ctx, ctx->data);
+			if (bitIsSet (is0, TDA_IS0_EOMB_OFF)) {
+				/* end of message indicator config B */
+				const tda5340Callback cb =
+						callback (ctx, rxeomb, RXEOMB) != NULL ?
+						callback (ctx, rxeomb, RXEOMB) : callback (ctx, rxeom, RXEOM);
+				if (cb != NULL) {
+					ctx->rxconfig = TDA_CONFIG_B;
+					cb (ctx, ctx->data);
+				}
 			}
 			break;
 		}
@@ -619,5 +1403,537 @@ void tda5340IrqHandle (tda5340Ctx * const ctx) {
 			assert (0);
 			break;
 	}
+
+	if (ctx->adc != NULL && ctx->mode != TDA_RESET_MODE) {
+		/* piggyback on the status read, no extra wake-up */
+		tda5340AdcPoll (ctx);
+	}
+
+	trace (ctx, TDA_TRACE_IRQ_EXIT, ctx->mode, status);
+	irqUnlock (ctx);
+}
+
+/*	Write/read-back test patterns through TDA_A_MID0, returns the number of
+ *	mismatches. SPIAT/SPIDT check what the TDA received, the register read
+ *	what we receive.
+ */
+static uint16_t spiTuneProbe (tda5340Ctx * const ctx, const uint16_t patterns) {
+	static const uint8_t fixed[] = {0x00, 0xff, 0x55, 0xaa};
+	tda5340HalSpi * const spi = ctxSpi (ctx);
+	uint16_t errors = 0;
+	uint8_t lfsr = 0x01;
+
+	spiStart (ctx, TDA_WR, TDA_A_MID0);
+	/* page might have been garbled by a previous setting */
+	regWriteNoSS (spi, TDA_SFRPAGE, 0);
+	ctx->page = 0;
+	for (uint16_t i = 0; i < patterns; i++) {
+		uint8_t pattern;
+		if (i < arraysize (fixed)) {
+			pattern = fixed[i];
+		} else {
+			/* x^8+x^6+x^5+x^4+1 */
+			lfsr = (lfsr >> 1) ^ (-(lfsr & 0x1) & 0xb8);
+			pattern = lfsr;
+		}
+		regWriteNoSS (spi, TDA_A_MID0, pattern);
+		if (regReadNoSS (spi, TDA_SPIAT) != TDA_A_MID0 ||
+				regReadNoSS (spi, TDA_SPIDT) != pattern ||
+				regReadNoSS (spi, TDA_A_MID0) != pattern) {
+			errors++;
+		}
+	}
+	spiEnd (ctx);
+
+	return errors;
+}
+
+/*	Find the fastest reliable SPI timing. Call after reset, before loading a
+ *	configuration (TDA_A_MID0 is restored though). For both shift clock
+ *	settings baudrates are tried in ascending order until one fails, the
+ *	setting one step below the fastest good one is used as margin (unless
+ *	no setting failed). Each setting needs four patterns at least.
+ *
+ *	Returns false and restores ctx->baudrate if not even the slowest
+ *	candidate works. Returns false as well if only the slowest one works,
+ *	it is used anyway, but without margin.
+ */
+bool tda5340SpiTune (tda5340Ctx * const ctx, tda5340SpiTiming * const tune) {
+	assert (ctx != NULL);
+	assert (tune != NULL && tune->baudrates != NULL && tune->count > 0);
+	assert (tune->patterns >= 4);
+	assert (ctx->mode == TDA_SLEEP_MODE);
+
+	const uint8_t mid0 = tda5340RegRead (ctx, TDA_A_MID0);
+
+	/* number of good baudrates for each delay setting */
+	uint8_t good[2] = {0, 0};
+	for (uint8_t d = 0; d < 2; d++) {
+		const bool delay = d == 0;
+		for (uint8_t i = 0; i < tune->count; i++) {
+			assert (i == 0 || tune->baudrates[i] > tune->baudrates[i-1]);
+			uint16_t errors = tune->patterns;
+			if (halSpiTiming (ctxSpi (ctx), tune->baudrates[i], delay)) {
+				errors = spiTuneProbe (ctx, tune->patterns);
+			}
+			if (tune->errors != NULL) {
+				tune->errors[d*tune->count+i] = errors;
+			}
+			if (errors > 0) {
+				break;
+			}
+			good[d] = i+1;
+		}
+	}
+
+	/* prefer delayed shift clock, which is the default */
+	const uint8_t d = good[1] > good[0] ? 1 : 0;
+	const bool found = good[d] > 0;
+	/* the next faster one failed, nothing to step back to */
+	const bool margin = good[d] == tune->count || good[d] > 1;
+	if (found) {
+		const uint8_t i = good[d] == tune->count || good[d] == 1 ?
+				good[d]-1 : good[d]-2;
+		tune->baudrate = tune->baudrates[i];
+		tune->delay = d == 0;
+		ctx->baudrate = tune->baudrate;
+		if (!margin) {
+			debug ("spi tune: only the slowest baudrate works, no margin\n");
+		}
+	}
+	halSpiTiming (ctxSpi (ctx), ctx->baudrate, found ? tune->delay : true);
+	ctx->page = 0xff;
+
+	const bool ret = tda5340RegWrite (ctx, TDA_A_MID0, mid0) && found && margin;
+	debug ("spi tuned to %u, delay %u\n", ctx->baudrate, found ? tune->delay : 1);
+
+	return ret;
 }
 
+#if !defined(TDA_STATIC_CONFIG)
+/*	Link layer transmit hook: switch to transmit mode (if required) and queue
+ *	the frame, tda5340TxQueuePush chains it if a frame is still going out
+ */
+static bool linkSend (tda5340Link * const link, const uint8_t * const data,
+		const size_t bits) {
+	tda5340LinkRadio * const radio = link->radio;
+	tda5340Ctx * const ctx = radio->ctx;
+	if (ctx->mode != TDA_TRANSMIT_MODE && !tda5340ModeSet (ctx,
+			TDA_TRANSMIT_MODE, ctx->sendbit, radio->txconfig)) {
+		return false;
+	}
+	return tda5340TxQueuePush (ctx, data, bits);
+}
+
+/*	End of message: hand the frame to the link, which replies from here
+ */
+static void linkRxeom (tda5340Ctx * const ctx, void * const data) {
+	tda5340LinkRadio * const radio = data;
+	size_t len = sizeof (radio->rxbuf);
+	if (tda5340FifoReadAll (ctx, (uint8_t *) radio->rxbuf, &len) == TDA_FIFO_OK) {
+		tda5340LinkReceive (radio->link, (uint8_t *) radio->rxbuf, len);
+	}
+}
+
+/*	Transmitter is done (and nothing queued), back to receiving
+ */
+static void linkTxready (tda5340Ctx * const ctx, void * const data) {
+	tda5340LinkRadio * const radio = data;
+	if (!ctx->txactive) {
+		tda5340ModeSet (ctx, TDA_RUN_MODE_SLAVE, false, radio->rxconfig);
+	}
+}
+
+/*	Drive radio->link (configured, but not initialized yet) with the TDA. This
+ *	takes over the rxeom, txready callbacks and callback data. ACKs are sent
+ *	from the interrupt handler right after EOM. tda5340LinkPoll and
+ *	tda5340LinkSend must not race with it, call them from a context with
+ *	the NINT interrupt’s priority. The TDA is left receiving.
+ */
+bool tda5340LinkAttach (tda5340LinkRadio * const radio) {
+	assert (radio != NULL && radio->ctx != NULL && radio->link != NULL);
+	assert (radio->ctx->clock != NULL);
+
+	tda5340Ctx * const ctx = radio->ctx;
+	tda5340Link * const link = radio->link;
+	link->send = linkSend;
+	link->now = ctx->clock;
+	link->radio = radio;
+	tda5340LinkInit (link);
+
+	ctx->rxeom = linkRxeom;
+	ctx->txready = linkTxready;
+	ctx->data = radio;
+
+	return tda5340ModeSet (ctx, TDA_RUN_MODE_SLAVE, false, radio->rxconfig);
+}
+#endif
+
+/*	Load rate preset, writing only the registers that differ from the current
+ *	one (a handful usually). The TDA is put to sleep, set the mode again
+ *	afterwards.
+ */
+bool tda5340AdrSwitch (tda5340Ctx * const ctx, tda5340AdrPresets * const presets,
+		const uint8_t rate) {
+	assert (ctx != NULL && presets != NULL);
+	assert (rate < presets->rates && presets->current < presets->rates);
+
+	if (rate == presets->current) {
+		return true;
+	}
+	if (!tda5340ModeSet (ctx, TDA_SLEEP_MODE, false, 0) ||
+			!tda5340RegWriteDiff (ctx, presets->cfg[presets->current],
+			presets->count[presets->current], presets->cfg[rate],
+			presets->count[rate])) {
+		return false;
+	}
+	presets->current = rate;
+	return true;
+}
+
+/*	Feed the received block to the bit error rate test, call from the rxeom
+ *	callback. Blocks are limited to the receive fifo size.
+ */
+bool tda5340BerReceive (tda5340Ctx * const ctx, tda5340Ber * const ber) {
+	assert (ctx != NULL && ber != NULL);
+
+	uint32_t buf[TDA_RXFIFO_SIZE/32];
+	size_t len = sizeof (buf);
+	if (tda5340FifoReadAll (ctx, (uint8_t *) buf, &len) != TDA_FIFO_OK) {
+		return false;
+	}
+	const uint8_t rssi = tda5340RegRead (ctx, TDA_RSSIPRX);
+	return tda5340BerFeed (ber, (const uint8_t *) buf, len, rssi);
+}
+
+/*	Enable antenna diversity. The driver does not measure anything, switching
+ *	is driven by the outcome of received frames, see tda5340DiversityFeed, so
+ *	the common path costs no SPI transactions at all. Learn the best antenna
+ *	per peer with tda5340DivFeed and select it with tda5340AntennaSelect
+ *	before transmitting.
+ */
+bool tda5340DiversityEnable (tda5340Ctx * const ctx, tda5340Diversity * const div) {
+	assert (ctx != NULL && div != NULL);
+
+	tda5340DivPeerInit (&div->link);
+	div->antenna = 0;
+	div->frames = 0;
+	div->switches = 0;
+	if (!tda5340RegWrite (ctx, TDA_ANTSW, div->antsw[0])) {
+		return false;
+	}
+	ctx->diversity = div;
+	return true;
+}
+
+/*	Record the outcome of a received frame (ok if the CRC matched, false for
+ *	an expected frame that never arrived), e.g. from the rxeom callback. Once
+ *	the current antenna's success rate degrades clearly below the other
+ *	one's, the receiver switches over, which costs a single, unverified ANTSW
+ *	write. An antenna not tried yet counts as mediocre, so a good link never
+ *	switches and a bad one probes the other antenna.
+ */
+void tda5340DiversityFeed (tda5340Ctx * const ctx, const bool ok) {
+	assert (ctx != NULL && ctx->diversity != NULL);
+
+	tda5340Diversity * const div = ctx->diversity;
+	div->frames++;
+	const uint8_t antenna = tda5340DivFeed (div->stats, &div->link,
+			div->antenna, false, ok);
+	tda5340AntennaSelect (ctx, antenna);
+}
+
+/*	Select antenna, e.g. the best one for a peer before transmitting. Costs a
+ *	single, unverified ANTSW write if it differs from the current one.
+ */
+void tda5340AntennaSelect (tda5340Ctx * const ctx, const uint8_t antenna) {
+	assert (ctx != NULL && ctx->diversity != NULL);
+	assert (antenna < TDA_ANTENNAS);
+
+	tda5340Diversity * const div = ctx->diversity;
+	if (antenna == div->antenna) {
+		return;
+	}
+	spiStart (ctx, TDA_WR, TDA_ANTSW);
+	antennaSwitchNoSS (ctx, div, antenna);
+	spiEnd (ctx);
+}
+
+/*	Start an asynchronous ADC measurement of adc->input. The TDA has no ADC
+ *	interrupt, so samples are taken whenever the interrupt handler runs
+ *	anyway, or by calling tda5340AdcPoll, e.g. from a timer if there is no
+ *	radio traffic. adc->done is called with the average of adc->samples
+ *	results. One measurement at a time. tda5340AdcPoll must not race with
+ *	the interrupt handler, call it from a context with the NINT interrupt’s
+ *	priority.
+ */
+bool tda5340AdcStart (tda5340Ctx * const ctx, tda5340Adc * const adc) {
+	assert (ctx != NULL && adc != NULL);
+	assert (adc->samples > 0 && adc->done != NULL);
+	assert (ctx->adc == NULL);
+
+	adc->sum = 0;
+	adc->taken = 0;
+	if (!tda5340RegWrite (ctx, TDA_ADCINSEL, adc->input)) {
+		return false;
+	}
+	ctx->adc = adc;
+	return true;
+}
+
+/*	Take one sample of the pending ADC measurement (if any) and deliver the
+ *	result once complete. ADCRESH holds the upper eight bits, ADCRESL the
+ *	lower two.
+ */
+void tda5340AdcPoll (tda5340Ctx * const ctx) {
+	assert (ctx != NULL);
+
+	tda5340Adc * const adc = ctx->adc;
+	if (adc == NULL) {
+		return;
+	}
+
+	spiStart (ctx, TDA_RD, TDA_ADCRESH);
+	const uint8_t high = regReadNoSS (ctxSpi (ctx), TDA_ADCRESH);
+	const uint8_t low = regReadNoSS (ctxSpi (ctx), TDA_ADCRESL);
+	spiEnd (ctx);
+
+	adc->sum += high << 2 | (low & 0x3);
+	if (++adc->taken < adc->samples) {
+		return;
+	}
+	adc->result = adc->sum / adc->samples;
+	/* done may start the next measurement */
+	ctx->adc = NULL;
+	adc->done (ctx, adc->data);
+}
+
+#if !defined(TDA_STATIC_CONFIG)
+/*	End of message: queue the frame for tda5340ReceiveWait
+ */
+static void osRxeom (tda5340Ctx * const ctx, void * const data) {
+	tda5340OsRadio * const radio = data;
+	tda5340RxFrame f;
+	size_t len = sizeof (f.data);
+	if (tda5340FifoReadAll (ctx, (uint8_t *) f.data, &len) != TDA_FIFO_OK) {
+		return;
+	}
+	if ((uint8_t) (radio->rxtail - radio->rxhead) >= TDA_RXQUEUE_LEN) {
+		radio->rxdropped++;
+		return;
+	}
+	f.bits = len;
+	f.config = ctx->rxconfig;
+	f.time = ctx->rxeomTime;
+	radio->rxqueue[radio->rxtail % TDA_RXQUEUE_LEN] = f;
+	radio->rxtail++;
+	osEventSet (&radio->events, TDA_EVENT_RXFRAME);
+}
+
+/*	Transmitter is done (and nothing queued), wake the sender and go back to
+ *	receiving
+ */
+static void osTxready (tda5340Ctx * const ctx, void * const data) {
+	tda5340OsRadio * const radio = data;
+	if (!ctx->txactive) {
+		tda5340ModeSet (ctx, TDA_RUN_MODE_SLAVE, false, radio->rxconfig);
+		osEventSet (&radio->events, TDA_EVENT_TXDONE);
+	}
+}
+
+static void osTxerror (tda5340Ctx * const ctx, void * const data) {
+	tda5340OsRadio * const radio = data;
+	osEventSet (&radio->events, TDA_EVENT_TXERROR);
+}
+
+/*	Blocking API for threads on top of the callbacks. This takes over the
+ *	rxeom, txready, txerror callbacks and callback data. Received frames are
+ *	queued by the interrupt handler, senders sleep until their frame is out.
+ *	The TDA is left receiving.
+ */
+bool tda5340OsAttach (tda5340OsRadio * const radio) {
+	assert (radio != NULL && radio->ctx != NULL);
+	tda5340Ctx * const ctx = radio->ctx;
+
+	osMutexInit (&radio->tx);
+	osMutexInit (&radio->rx);
+	osEventInit (&radio->events);
+	radio->rxhead = 0;
+	radio->rxtail = 0;
+	radio->rxdropped = 0;
+
+	irqLock (ctx);
+	ctx->rxeom = osRxeom;
+	ctx->txready = osTxready;
+	ctx->txerror = osTxerror;
+	ctx->data = radio;
+	const bool ret = modeSet (ctx, TDA_RUN_MODE_SLAVE, false, radio->rxconfig);
+	irqUnlock (ctx);
+
+	return ret;
+}
+
+/*	Wait up to timeout μs for any of the event flags (TDA_EVENT_*), returns
+ *	and clears the ones that were set, 0 on timeout
+ */
+uint32_t tda5340EventWait (tda5340OsRadio * const radio, const uint32_t flags,
+		const uint32_t timeout) {
+	assert (radio != NULL);
+	return osEventWait (&radio->events, flags, timeout);
+}
+
+/*	Send a frame and wait up to timeout μs until it is out. Returns false on
+ *	transmission error or timeout.
+ */
+bool tda5340SendWait (tda5340OsRadio * const radio, const uint8_t * const data,
+		const size_t bits, const uint32_t timeout) {
+	assert (radio != NULL);
+	tda5340Ctx * const ctx = radio->ctx;
+
+	osMutexLock (&radio->tx);
+	/* stale events of an earlier, timed out frame */
+	osEventWait (&radio->events, TDA_EVENT_TXDONE | TDA_EVENT_TXERROR, 0);
+	/* a late txready of a timed out frame must not switch back to receiving
+	 * between mode check and push */
+	irqLock (ctx);
+	bool ret = (ctx->mode == TDA_TRANSMIT_MODE || modeSet (ctx,
+			TDA_TRANSMIT_MODE, ctx->sendbit, radio->txconfig)) &&
+			tda5340TxQueuePush (ctx, data, bits);
+	irqUnlock (ctx);
+	if (ret) {
+		ret = osEventWait (&radio->events, TDA_EVENT_TXDONE | TDA_EVENT_TXERROR,
+				timeout) == TDA_EVENT_TXDONE;
+	}
+	osMutexUnlock (&radio->tx);
+
+	return ret;
+}
+
+/*	Wait up to timeout μs for a received frame and copy it to frame
+ */
+bool tda5340ReceiveWait (tda5340OsRadio * const radio, tda5340RxFrame * const frame,
+		const uint32_t timeout) {
+	assert (radio != NULL && frame != NULL);
+	assert (timeout == TDA_OS_FOREVER || tda5340TimeRunning ());
+
+	osMutexLock (&radio->rx);
+	const uint32_t start = tda5340TimeNow ();
+	bool ret = false;
+	while (true) {
+		irqLock (radio->ctx);
+		if (radio->rxhead != radio->rxtail) {
+			*frame = radio->rxqueue[radio->rxhead % TDA_RXQUEUE_LEN];
+			radio->rxhead++;
+			ret = true;
+		}
+		irqUnlock (radio->ctx);
+		if (ret) {
+			break;
+		}
+		/* the event may belong to a frame that was taken already, wait
+		 * for the remaining time */
+		const uint32_t elapsed = tda5340TimeNow () - start;
+		if (timeout != TDA_OS_FOREVER && elapsed >= timeout) {
+			break;
+		}
+		osEventWait (&radio->events, TDA_EVENT_RXFRAME,
+				timeout == TDA_OS_FOREVER ? timeout : timeout - elapsed);
+	}
+	osMutexUnlock (&radio->rx);
+
+	return ret;
+}
+#endif
+
+/*	Switch to polled NINT handling, for dedicated receive loops around
+ *	tda5340PollReceive. The interrupt stays disabled and only end of message
+ *	and receive fifo almost full are unmasked, call after tda5340ModeSet
+ *	(which reprograms the masks) and switch back before transmitting.
+ */
+bool tda5340PollEnable (tda5340Ctx * const ctx, const bool enable) {
+	assert (ctx != NULL);
+
+	/* NINT is enabled again on unlock unless polled */
+	irqLock (ctx);
+	ctx->polled = enable;
+	bool ret;
+	if (!enable) {
+		ret = tda5340IrqMaskUpdate (ctx, ctx->mode);
+	} else {
+		const uint8_t im0 = 0xff & ~(1 << TDA_IM0_EOMA_OFF | 1 << TDA_IM0_EOMB_OFF),
+				im2 = 0xff & ~(1 << TDA_IM2_RXAF_OFF);
+		ret = tda5340RegWrite (ctx, TDA_IM0, im0) &&
+				tda5340RegWrite (ctx, TDA_IM2, im2);
+		if (ret) {
+			ctx->im[0] = im0;
+			ctx->im[2] = im2;
+			ctx->pollFrames = 0;
+			ctx->pollDropped = 0;
+			ctx->pollPartial = false;
+		}
+	}
+	irqUnlock (ctx);
+	return ret;
+}
+
+/*	Spin on NINT for up to timeout μs (TDA_OS_FOREVER) until a frame is
+ *	received into data, which can hold up to len _bytes_. len is set to
+ *	received _bits_. Status registers and fifo are read in one bus
+ *	transaction per event, no callbacks are involved. The deadline is checked
+ *	on every iteration, a frame cut short by it is reported as dropped by the
+ *	next call.
+ *
+ *	Each event costs a single bus ownership instead of one per fifo word and
+ *	there is no interrupt entry or dispatch, but the sustained frame rate
+ *	compared to the interrupt path has not been measured on hardware yet.
+ */
+tda5340PollStatus tda5340PollReceive (tda5340Ctx * const ctx, uint8_t * const data,
+		size_t * const len, const uint32_t timeout) {
+	assert (ctx != NULL && ctx->polled);
+	assert (ctx->mode == TDA_RUN_MODE_SLAVE || ctx->mode == TDA_SELF_POLLING_MODE);
+	assert (data != NULL && len != NULL);
+	assert (timeout == TDA_OS_FOREVER || tda5340TimeRunning ());
+
+	tda5340HalSpi * const spi = ctxSpi (ctx);
+	bitbuffer bb;
+	bitbufferInit (&bb, (uint32_t *) data, (*len)*8);
+	bool ok = true;
+	const uint32_t start = halTimeNow ();
+
+	while (true) {
+		if (timeout != TDA_OS_FOREVER && halTimeNow () - start >= timeout) {
+			if (bitbufferLength (&bb) > 0) {
+				ctx->pollPartial = true;
+			}
+			return TDA_POLL_TIMEOUT;
+		}
+		if (!halNintFlag (spi)) {
+			continue;
+		}
+
+		spiStart (ctx, TDA_RD, TDA_IS0);
+		const uint8_t is0 = regReadNoSS (spi, TDA_IS0);
+		const uint8_t is2 = regReadNoSS (spi, TDA_IS2);
+		const bool eom = bitIsSet (is0, TDA_IS0_EOMA_OFF) ||
+				bitIsSet (is0, TDA_IS0_EOMB_OFF);
+		if (eom || bitIsSet (is2, TDA_IS2_RXAF_OFF)) {
+			ok = fifoDrainNoSS (spi, &bb) && ok;
+		}
+		spiEnd (ctx);
+
+		if (!eom) {
+			continue;
+		}
+		ctx->rxconfig = bitIsSet (is0, TDA_IS0_EOMA_OFF) ? TDA_CONFIG_A :
+				TDA_CONFIG_B;
+		ctx->rxeomTime = ctx->clock != NULL ? ctx->clock () : 0;
+		if (!ok || ctx->pollPartial) {
+			ctx->pollPartial = false;
+			ctx->pollDropped++;
+			return TDA_POLL_DROPPED;
+		}
+		ctx->pollFrames++;
+		*len = bitbufferLength (&bb);
+		return TDA_POLL_FRAME;
+	}
+}
@@ -22,29 +22,190 @@ THE SOFTWARE.
 
 #pragma once
 
-#include <xmc_usic.h>
+#include "tda5340_hal.h"
+#include "tda5340_os.h"
 
 #include "tda5340_reg.h"
+#include "tda5340_cca.h"
+#include "tda5340_afc.h"
+#include "tda5340_trace.h"
+#include "tda5340_time.h"
+#include "tda5340_frame.h"
+#include "tda5340_link.h"
+#include "tda5340_adr.h"
+#include "tda5340_ber.h"
+#include "tda5340_div.h"
 
 typedef struct {
 	uint16_t reg;
 	uint8_t val;
 } tdaConfigVal;
 
+/* transmit fifo size, in bits */
+#define TDA_TXFIFO_SIZE 256
+/* receive fifo size, in bits */
+#define TDA_RXFIFO_SIZE 288
+/* number of frames waiting in the transmit queue, excluding the one on air.
+ * Queued frames are sent back-to-back and must carry their own preamble and
+ * sync word, see tda5340TxQueuePush */
+#define TDA_TXQUEUE_LEN 2
+
+typedef struct {
+	uint8_t data[TDA_TXFIFO_SIZE/8];
+	uint16_t bits;
+} tda5340TxFrame;
+
+/* telegram start identifier (sync word) of one config, see TSIMODE */
+typedef struct {
+	/* raw TSIMODE value */
+	uint8_t mode;
+	/* pattern A/B length in bits and pattern, TSIPTx0 holds the low byte */
+	uint8_t lenA, lenB;
+	uint16_t patternA, patternB;
+	/* raw TSIGAP value */
+	uint8_t gap;
+} tda5340Tsi;
+
+/* number of PLL channel slots per configuration, PLLINTC1..C4 */
+#define TDA_PLL_CHANNELS 4
+
+/* PLL channel, see PLLINTCx and PLLFRAC0Cx..PLLFRAC2Cx */
+typedef struct {
+	uint8_t pllint;
+	/* 24 bit fractional divider */
+	uint32_t pllfrac;
+} tda5340Channel;
+
+/* channel occupancy survey, see tda5340ScanRun */
+typedef struct {
+	/* channels to visit, loaded into PLL slot C1 one after another */
+	const tda5340Channel *channels;
+	uint8_t count;
+	/* rssi samples per channel and μs between them */
+	uint8_t dwell;
+	uint32_t interval;
+	/* occupancy histogram, count*bins saturating counters, RSSIRX range is
+	 * split evenly into bins */
+	uint8_t *histogram;
+	uint8_t bins;
+	/* duration of the last scan in μs, requires clock */
+	uint32_t duration;
+} tda5340Scan;
+
+/* configuration registers per page (0x00…0x84) and mirrored ones, see
+ * TDA_REG_CONFIG */
+#define TDA_SNAPSHOT_PAGED TDA_REG_CONFIG_PAGED
+#define TDA_SNAPSHOT_MIRRORED TDA_REG_CONFIG_MIRRORED
+#define TDA_SNAPSHOT_SIZE (TDA_SNAPSHOT_MIRRORED + 4*TDA_SNAPSHOT_PAGED)
+
+/* register state image, plain data, can be stored in flash as is */
+typedef struct {
+	/* mirrored registers, then config A…D, each in address order */
+	uint8_t val[TDA_SNAPSHOT_SIZE];
+	/* fletcher-16 of val */
+	uint16_t checksum;
+} tda5340Snapshot;
+
+typedef enum {
+	TDA_RESTORE_PENDING = 0,
+	TDA_RESTORE_DONE,
+	/* snapshot checksum invalid or register mismatch after writing */
+	TDA_RESTORE_CORRUPT,
+	TDA_RESTORE_ERROR,
+} tda5340RestoreStatus;
+
+/* non-blocking restore state, see tda5340RestoreStep */
+typedef struct {
+	const tda5340Snapshot *snap;
+	/* registers written/verified per step */
+	uint16_t budget;
+	/* duration from first to last step in μs, requires clock */
+	uint32_t duration;
+
+	/* private data, do not touch */
+	uint16_t cursor, pos;
+	bool verify;
+	uint16_t sum1, sum2;
+	uint32_t start;
+} tda5340Restore;
+
+/* spi timing calibration, see tda5340SpiTune */
+typedef struct {
+	/* candidate baudrates, ascending */
+	const uint32_t *baudrates;
+	uint8_t count;
+	/* write/read-back patterns per setting */
+	uint16_t patterns;
+	/* optional, count*2 mismatch counters, delayed shift clock first */
+	uint16_t *errors;
+	/* selected baudrate and shift clock delay */
+	uint32_t baudrate;
+	bool delay;
+} tda5340SpiTiming;
+
+/* antenna diversity, see tda5340DiversityEnable */
+typedef struct {
+	/* ANTSW value selecting each antenna, depends on the board */
+	uint8_t antsw[TDA_ANTENNAS];
+	/* optional, success rates per antenna, see tda5340DiversityFeed */
+	tda5340DivStats *stats;
+	/* received frames fed and ANTSW writes */
+	uint32_t frames, switches;
+
+	/* antenna selected, valid inside receive callbacks */
+	uint8_t antenna;
+
+	/* private data, do not touch */
+	/* receive success rate per antenna, across all peers */
+	tda5340DivPeer link;
+} tda5340Diversity;
+
 struct tda5340;
 typedef void (*tda5340Callback) (struct tda5340 * const, void * const);
+/* free running μs clock, used for latency measurements */
+typedef uint32_t (*tda5340Clock) (void);
+
+/* on-chip ADC measurement, see tda5340AdcStart */
+typedef struct {
+	/* raw ADCINSEL value */
+	uint8_t input;
+	/* samples averaged per result */
+	uint8_t samples;
+	/* called from the interrupt handler when done */
+	tda5340Callback done;
+	void *data;
+	/* averaged 10 bit result, valid inside done */
+	uint16_t result;
+
+	/* private data, do not touch */
+	uint32_t sum;
+	uint8_t taken;
+} tda5340Adc;
 
 typedef struct tda5340 {
 	/* configuration, fill before calling init */
 	/* init fifo at frame start, see FSINITRXFIFO */
 	bool fsInitFifo;
+	/* take rxfsyncTime on every frame sync even without rxfsync callback,
+	 * for slots aligned to a beacon, see tda5340TransmissionSchedule */
+	bool fsyncTime;
 	/* spi baudrate */
 	uint32_t baudrate;
 	/* max retries for SPI register write */
 	uint8_t retries;
+	/* tx fifo almost empty level in bits (TXFIFOAEL), 0 keeps chip default.
+	 * Queued frames are appended once the fifo drained below it */
+	uint8_t txfifoAel;
 
 	/* spi channel */
-	XMC_USIC_CH_t *spi;
+	tda5340HalSpi *spi;
+	/* μs clock for timestamps and latency measurements, tda5340Init
+	 * defaults to tda5340TimeNow if the timebase is running */
+	tda5340Clock clock;
+	/* optional event trace, requires TDA_TRACE */
+	tda5340Trace *trace;
+	/* optional antenna diversity, see tda5340DiversityEnable */
+	tda5340Diversity *diversity;
 
 	/* callbacks */
 	/* transmission error */
@@ -60,23 +221,135 @@ typedef struct tda5340 {
 	/* receiver got end of message */
 			rxeom,
 	/* receive fifo almost full */
-			rxaf;
+			rxaf,
+	/* config B receiver synchronized and end of message, rxfsync/rxeom are
+	 * used for config B as well if NULL */
+			rxfsyncb,
+			rxeomb;
 	/* callback data */
 	void *data;
 
 	/* private data, do not touch */
 	/* current mode, see TDA_CMC, written by isr */
 	volatile uint8_t mode;
+	/* config (TDA_CONFIG_A or B) the current receive event belongs to, valid
+	 * inside receive callbacks */
+	uint8_t rxconfig;
 	/* transmission mode: with/without start bit */
 	bool sendbit;
 	/* current page, avoids setting it every time */
 	uint8_t page;
 	/* locking flag ensuring atomic SPI transactions, for debugging only */
 	uint8_t lock;
+	/* transmit queue, frames are appended to the fifo by the isr */
+	tda5340TxFrame txqueue[TDA_TXQUEUE_LEN];
+	uint8_t txhead, txcount;
+	/* transmitter is busy sending data from the fifo */
+	volatile bool txactive;
+	/* interrupt masks IM0…IM2 currently programmed */
+	uint8_t im[3];
+	/* interrupt events delivered to the driver/callbacks and masked events
+	 * seen alongside delivered ones. Masked events never raise NINT, so
+	 * irqFiltered only counts those latched when an unmasked event is
+	 * handled, it is a lower bound, not the number of events saved */
+	uint32_t irqDelivered, irqFiltered;
+	/* duration of the last channel hop in μs, requires clock */
+	uint32_t hopLatency;
+	/* listen before talk turnaround (last rssi sample until transmission
+	 * start) in μs, requires clock */
+	uint32_t lbtLatency;
+	/* timestamps of the last NINT, frame sync and end of message events,
+	 * valid inside callbacks, requires clock */
+	uint32_t nintTime, rxfsyncTime, rxeomTime;
+	/* scheduled transmission: prepared TXC write, start time and when it
+	 * was actually written, txStartTime - txat is the lateness */
+	uint8_t txstaged[3];
+	uint32_t txat, txStartTime;
+	volatile bool txscheduled;
+	/* scheduled starts written after txat, because the timer interrupt was
+	 * delayed (bus transactions mask it) beyond SCHEDULE_SPIN, and the
+	 * worst lateness in μs */
+	uint32_t txLateStarts, txLateMax;
+	/* interrupt priority, scheduling timer is set up on first use */
+	uint32_t priority;
+	bool timer;
+	/* pending ADC measurement, sampled by the isr */
+	tda5340Adc * volatile adc;
+	/* driver ownership between threads (recursive) and irqLock nesting,
+	 * see tda5340_os.h */
+	tda5340OsMutex bus;
+	uint8_t irqDepth;
+	/* NINT is polled, its interrupt stays disabled, see tda5340PollEnable */
+	bool polled;
+	/* polled receive: frames delivered and dropped (fifo overflow, buffer
+	 * too small, cut by a timeout) */
+	uint32_t pollFrames, pollDropped;
+	/* a timeout interrupted a frame, its tail is dropped */
+	bool pollPartial;
 } tda5340Ctx;
 
 typedef uint16_t tda5340Address;
 
+/* rate presets for tda5340AdrSwitch, built with TDA_CFG_TXBAUDRATE and
+ * TDA_CFG_RXBAUDRATE, index 0 is the slowest */
+typedef struct {
+	const tdaConfigVal *cfg[TDA_ADR_RATES];
+	size_t count[TDA_ADR_RATES];
+	uint8_t rates;
+	/* preset loaded last */
+	uint8_t current;
+} tda5340AdrPresets;
+
+/* binds a tda5340Link to a TDA, see tda5340LinkAttach */
+typedef struct {
+	tda5340Ctx *ctx;
+	tda5340Link *link;
+	/* receive and transmit configuration (TDA_CONFIG_A…D) */
+	uint8_t rxconfig, txconfig;
+
+	/* private data, do not touch */
+	/* receive buffer, word aligned for tda5340FifoReadAll */
+	uint32_t rxbuf[2*TDA_LINK_FRAME_SIZE/4];
+} tda5340LinkRadio;
+
+/* frames buffered for tda5340ReceiveWait */
+#define TDA_RXQUEUE_LEN 4
+
+typedef struct {
+	uint32_t data[TDA_RXFIFO_SIZE/32];
+	uint16_t bits;
+	/* config (TDA_CONFIG_A or B) and end of message timestamp */
+	uint8_t config;
+	uint32_t time;
+} tda5340RxFrame;
+
+/* event flags, see tda5340EventWait */
+enum {
+	TDA_EVENT_TXDONE = 1 << 0,
+	TDA_EVENT_TXERROR = 1 << 1,
+	TDA_EVENT_RXFRAME = 1 << 2,
+};
+
+/* blocking API for threads, see tda5340OsAttach */
+typedef struct {
+	tda5340Ctx *ctx;
+	/* receive and transmit configuration (TDA_CONFIG_A…D) */
+	uint8_t rxconfig, txconfig;
+	/* frames dropped, because the queue was full */
+	uint32_t rxdropped;
+
+	/* private data, do not touch */
+	/* serialize senders and receivers */
+	tda5340OsMutex tx, rx;
+	tda5340OsEvent events;
+	/* single producer (isr), single consumer (under rx) ring */
+	tda5340RxFrame rxqueue[TDA_RXQUEUE_LEN];
+	volatile uint8_t rxhead, rxtail;
+} tda5340OsRadio;
+
+/* translate a config A register address to config (TDA_CONFIG_A…D) */
+#define tdaConfigAddress(config, regA) ((tda5340Address) ((regA) + ((config) << 8)))
+
 /* SPI commands */
 #define TDA_WR 0x2 /* write to chip */
 #define TDA_RD 0x3 /* read from chip */
@@ -106,6 +379,10 @@ typedef uint16_t tda5340Address;
 #define TDA_TXC_INITTXFIFO_OFF 5
 #define TDA_TXC_TXSTART_OFF 7
 
+/* TXCHNL */
+#define TDA_TXCHNL_PLLCH_OFF 0
+#define TDA_TXCHNL_PLLCH_MSK 0x3
+
 /* RXC */
 #define TDA_RXC_RESET (0x84)
 #define TDA_RXC_INITRXFIFO_OFF (3)
@@ -122,6 +399,7 @@ typedef uint16_t tda5340Address;
 #define TDA_IS0_WUA_OFF (0)
 #define TDA_IS0_FSYNCA_OFF (1)
 #define TDA_IS0_EOMA_OFF (3)
+#define TDA_IS0_WUB_OFF (4)
 #define TDA_IS0_FSYNCB_OFF (5)
 #define TDA_IS0_EOMB_OFF (7)
 
@@ -149,8 +427,12 @@ enum {
 	TDA_IM2_TXERROR_OFF = 7,
 };
 
-/* receive fifo size, in bits */
-#define TDA_RXFIFO_SIZE 288
+typedef enum {
+	TDA_POLL_FRAME = 0,
+	TDA_POLL_TIMEOUT,
+	/* fifo overflow, supplied buffer too small or cut by a timeout */
+	TDA_POLL_DROPPED,
+} tda5340PollStatus;
 
 typedef enum {
 	TDA_FIFO_OK = 0x0,
@@ -162,22 +444,86 @@ typedef enum {
 
 void tda5340Init (tda5340Ctx * const ctx, const uint32_t priority);
 void tda5340Reset (tda5340Ctx * const ctx);
+void tda5340PowerOff (tda5340Ctx * const ctx);
 bool tda5340RegWriteBulk (tda5340Ctx * const ctx, const tdaConfigVal * const cfg, size_t count);
+bool tda5340RegWriteDiff (tda5340Ctx * const ctx, const tdaConfigVal * const from,
+		const size_t fromCount, const tdaConfigVal * const to,
+		const size_t toCount);
 bool tda5340RegWrite (tda5340Ctx * const ctx, const tda5340Address, const uint8_t);
 uint8_t tda5340RegRead (tda5340Ctx * const ctx, const tda5340Address);
 bool tda5340ModeSet (tda5340Ctx * const ctx, const uint8_t mode, const bool, const uint8_t);
+bool tda5340IrqMaskUpdate (tda5340Ctx * const ctx, const uint8_t mode);
 uint8_t tda5340Receive (tda5340Ctx * const ctx, uint8_t * const data);
 void tda5340IrqHandle (tda5340Ctx * const ctx);
-void tda5340FifoWrite (tda5340Ctx * const ctx, const uint8_t *data, const size_t bits);
+bool tda5340FifoWrite (tda5340Ctx * const ctx, const uint8_t *data, const size_t bits);
 bool tda5340TransmissionStart (tda5340Ctx * const ctx);
+bool tda5340TransmissionSchedule (tda5340Ctx * const ctx, const uint32_t at);
+void tda5340TimerHandle (tda5340Ctx * const ctx);
+bool tda5340TxQueuePush (tda5340Ctx * const ctx, const uint8_t * const data,
+		const size_t bits);
+bool tda5340SnapshotCapture (tda5340Ctx * const ctx, tda5340Snapshot * const snap);
+void tda5340RestoreInit (tda5340Restore * const r, const tda5340Snapshot * const snap,
+		const uint16_t budget);
+tda5340RestoreStatus tda5340RestoreStep (tda5340Ctx * const ctx,
+		tda5340Restore * const r);
+bool tda5340TsiSet (tda5340Ctx * const ctx, const uint8_t config,
+		const tda5340Tsi * const tsi);
+bool tda5340HopSetup (tda5340Ctx * const ctx, const uint8_t config,
+		const tda5340Channel * const channels, const uint8_t count,
+		const uint16_t offset);
+bool tda5340Hop (tda5340Ctx * const ctx, const uint8_t channel);
+bool tda5340TxPowerSet (tda5340Ctx * const ctx, const uint8_t config,
+		const uint8_t power);
+bool tda5340ScanRun (tda5340Ctx * const ctx, const uint8_t config,
+		tda5340Scan * const scan);
+bool tda5340XtalCalSet (tda5340Ctx * const ctx, const uint16_t xtalcal);
+bool tda5340AfcUpdate (tda5340Ctx * const ctx, tda5340Afc * const afc);
+tda5340CcaStatus tda5340Lbt (tda5340Ctx * const ctx, const uint8_t rxconfig,
+		const uint8_t txconfig, const uint8_t * const data, const size_t bits,
+		tda5340Cca * const cca, const uint32_t interval);
 bool tda5340FifoRead (tda5340Ctx * const ctx, uint32_t * const retData,
 		uint8_t * const retSize);
 tda5340FifoReadStatus tda5340FifoReadAll (tda5340Ctx * const ctx, uint8_t * const data,
 		size_t * const dataLen);
-
-/* IRQ handler name */
-#define TDA5350IRQHANDLER ERU0_3_IRQHandler
+bool tda5340SpiTune (tda5340Ctx * const ctx, tda5340SpiTiming * const tune);
+#if !defined(TDA_STATIC_CONFIG)
+bool tda5340LinkAttach (tda5340LinkRadio * const radio);
+#endif
+bool tda5340AdrSwitch (tda5340Ctx * const ctx, tda5340AdrPresets * const presets,
+		const uint8_t rate);
+bool tda5340BerReceive (tda5340Ctx * const ctx, tda5340Ber * const ber);
+bool tda5340DiversityEnable (tda5340Ctx * const ctx, tda5340Diversity * const div);
+void tda5340DiversityFeed (tda5340Ctx * const ctx, const bool ok);
+void tda5340AntennaSelect (tda5340Ctx * const ctx, const uint8_t antenna);
+bool tda5340AdcStart (tda5340Ctx * const ctx, tda5340Adc * const adc);
+void tda5340AdcPoll (tda5340Ctx * const ctx);
+#if !defined(TDA_STATIC_CONFIG)
+bool tda5340OsAttach (tda5340OsRadio * const radio);
+uint32_t tda5340EventWait (tda5340OsRadio * const radio, const uint32_t flags,
+		const uint32_t timeout);
+bool tda5340SendWait (tda5340OsRadio * const radio, const uint8_t * const data,
+		const size_t bits, const uint32_t timeout);
+bool tda5340ReceiveWait (tda5340OsRadio * const radio, tda5340RxFrame * const frame,
+		const uint32_t timeout);
+#endif
+bool tda5340PollEnable (tda5340Ctx * const ctx, const bool enable);
+tda5340PollStatus tda5340PollReceive (tda5340Ctx * const ctx, uint8_t * const data,
+		size_t * const len, const uint32_t timeout);
 
 #include "tda5340_reg.h"
 #include "tda5340_presets.h"
 
+/* Single radio build: define TDA_STATIC_CONFIG to a header defining
+ *
+ * TDA_STATIC_SPI: spi channel, a constant expression, e.g. XMC_SPI0_CH0
+ * TDA_STATIC_RETRIES: max retries for SPI register write
+ * TDA_STATIC_TXERROR, TDA_STATIC_TXREADY, … TDA_STATIC_RXEOMB: callbacks, see
+ *	tda5340Ctx, optional, NULL if absent (txerror defaults to an assert)
+ *
+ * The driver uses those instead of the spi, retries and callback fields of
+ * tda5340Ctx, which are ignored. tda5340LinkAttach and tda5340OsAttach
+ * install callbacks at runtime and are not available. */
+#if defined(TDA_STATIC_CONFIG)
+#include TDA_STATIC_CONFIG
+#endif
+
@@ -0,0 +1,108 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <stddef.h>
+
+#include "tda5340_adr.h"
+
+void tda5340AdrInit (tda5340AdrPeer * const peer, const uint8_t rate) {
+	assert (peer != NULL);
+
+	peer->rate = rate;
+	peer->rssi = 0;
+	peer->frames = 0;
+	peer->errors = 0;
+	peer->good = 0;
+}
+
+/*	Averaged RSSIPRX of peer
+ */
+uint8_t tda5340AdrRssi (const tda5340Adr * const adr,
+		const tda5340AdrPeer * const peer) {
+	return peer->rssi >> adr->shift;
+}
+
+/*	Start a new evaluation window
+ */
+static void windowReset (tda5340AdrPeer * const peer) {
+	peer->frames = 0;
+	peer->errors = 0;
+}
+
+/*	Feed the outcome of one frame exchanged with peer: RSSIPRX of its last
+ *	frame, whether the CRC matched and how many retransmissions were needed.
+ *	Returns the rate to use for peer from now on.
+ */
+uint8_t tda5340AdrFeed (const tda5340Adr * const adr,
+		tda5340AdrPeer * const peer, const uint8_t rssi, const bool crcOk,
+		const uint8_t retries) {
+	assert (adr != NULL && peer != NULL);
+	assert (adr->rates > 0 && adr->rates <= TDA_ADR_RATES);
+	assert (adr->window > 0);
+	assert (adr->shift < 8);
+	assert (peer->rate < adr->rates);
+
+	if (peer->rssi == 0) {
+		peer->rssi = rssi << adr->shift;
+	} else {
+		peer->rssi = peer->rssi - (peer->rssi >> adr->shift) + rssi;
+	}
+	const uint8_t avg = tda5340AdrRssi (adr, peer);
+
+	const uint16_t errors = peer->errors + !crcOk + retries;
+	peer->errors = errors > UINT8_MAX ? UINT8_MAX : errors;
+	peer->frames++;
+
+	/* step down right away if the link breaks down, as far as the signal
+	 * requires */
+	if (peer->errors > adr->maxErrors || avg < adr->rssiMin[peer->rate]) {
+		uint8_t rate = peer->rate;
+		if (rate > 0) {
+			rate--;
+		}
+		while (rate > 0 && avg < adr->rssiMin[rate]) {
+			rate--;
+		}
+		peer->rate = rate;
+		peer->good = 0;
+		windowReset (peer);
+		return peer->rate;
+	}
+
+	if (peer->frames >= adr->window) {
+		/* step up carefully, one rate at a time and after a couple of clean
+		 * windows only */
+		const uint8_t up = peer->rate + 1;
+		if (peer->errors == 0 && up < adr->rates && avg >= adr->rssiMin[up]) {
+			if (++peer->good >= adr->upWindows) {
+				peer->rate = up;
+				peer->good = 0;
+			}
+		} else {
+			peer->good = 0;
+		}
+		windowReset (peer);
+	}
+
+	return peer->rate;
+}
@@ -0,0 +1,66 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Adaptive data rate, independent of the hardware. Tracks the link quality
+ * of a peer (averaged RSSIPRX of its frames, CRC failures and
+ * retransmissions) and picks the fastest rate with enough margin. Index 0 is
+ * the slowest rate, e.g. the 5, 50 and 100 kchip/s presets. Both ends must
+ * agree on the rate, e.g. by keeping config B on the slowest one, see
+ * tda5340AdrSwitch for loading presets. */
+
+#define TDA_ADR_RATES 4
+
+typedef struct {
+	/* number of rates */
+	uint8_t rates;
+	/* minimum averaged RSSIPRX for each rate, including margin */
+	uint8_t rssiMin[TDA_ADR_RATES];
+	/* frames per evaluation window and errors (CRC failures, retries) per
+	 * window that cause a step down right away */
+	uint8_t window, maxErrors;
+	/* error-free windows required before stepping up */
+	uint8_t upWindows;
+	/* RSSI averaging weight is 1/2^shift */
+	uint8_t shift;
+} tda5340Adr;
+
+typedef struct {
+	/* current rate */
+	uint8_t rate;
+
+	/* private data, do not touch */
+	/* running RSSI average, scaled by 2^shift, 0 if no sample yet */
+	uint16_t rssi;
+	uint8_t frames, errors, good;
+} tda5340AdrPeer;
+
+void tda5340AdrInit (tda5340AdrPeer * const peer, const uint8_t rate);
+uint8_t tda5340AdrFeed (const tda5340Adr * const adr,
+		tda5340AdrPeer * const peer, const uint8_t rssi, const bool crcOk,
+		const uint8_t retries);
+uint8_t tda5340AdrRssi (const tda5340Adr * const adr,
+		const tda5340AdrPeer * const peer);
@@ -0,0 +1,93 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <stddef.h>
+
+#include "tda5340_afc.h"
+
+/*	Reset tracking state and start from xtalcal (i.e. the persisted value).
+ *	Tuning parameters must be set before.
+ */
+void tda5340AfcInit (tda5340Afc * const afc, const uint16_t xtalcal) {
+	assert (afc != NULL);
+	assert (afc->shift < 16);
+	assert (xtalcal <= afc->xtalcalMax);
+
+	afc->xtalcal = xtalcal;
+	afc->sum = 0;
+	afc->frames = 0;
+}
+
+/*	Current frequency offset estimate in AFCOFFSET units
+ */
+int16_t tda5340AfcOffset (const tda5340Afc * const afc) {
+	assert (afc != NULL);
+	return afc->sum >> afc->shift;
+}
+
+/*	Feed AFCOFFSET of one received frame. Returns true if xtalcal was changed
+ *	and must be applied (and persisted).
+ */
+bool tda5340AfcFeed (tda5340Afc * const afc, const int8_t offset) {
+	assert (afc != NULL);
+
+	if (afc->frames == 0) {
+		/* seed with the first sample after init or a correction, starting
+		 * from 0 would bias the average towards no offset */
+		afc->sum = (int32_t) offset * (1 << afc->shift);
+	} else {
+		/* exponential moving average, no division */
+		afc->sum += offset - (afc->sum >> afc->shift);
+	}
+	if (afc->frames < (1 << afc->shift)) {
+		++afc->frames;
+		return false;
+	}
+
+	const int16_t estimate = tda5340AfcOffset (afc);
+	if (estimate <= afc->hysteresis && estimate >= -afc->hysteresis) {
+		return false;
+	}
+
+	int32_t delta = ((int32_t) estimate * afc->gain) / 256;
+	if (delta == 0) {
+		/* always move at least one step */
+		delta = (estimate > 0) == (afc->gain > 0) ? 1 : -1;
+	}
+	int32_t next = (int32_t) afc->xtalcal + delta;
+	if (next < 0) {
+		next = 0;
+	} else if (next > afc->xtalcalMax) {
+		next = afc->xtalcalMax;
+	}
+	if (next == afc->xtalcal) {
+		/* end of range */
+		return false;
+	}
+
+	afc->xtalcal = next;
+	/* old samples were taken with the previous calibration */
+	afc->sum = 0;
+	afc->frames = 0;
+	return true;
+}
@@ -0,0 +1,54 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Crystal calibration tracking. AFCOFFSET samples from received frames are
+ * averaged and turned into XTALCAL corrections, independent of the
+ * hardware, so it can be driven by a simulated drift profile. */
+
+typedef struct {
+	/* averaging weight is 1/2^shift, also the number of frames required
+	 * before the first decision */
+	uint8_t shift;
+	/* correct only if the averaged offset exceeds this, AFCOFFSET units */
+	uint8_t hysteresis;
+	/* XTALCAL steps per AFCOFFSET unit, 8.8 fixed point, negative if a
+	 * higher XTALCAL lowers the offset */
+	int16_t gain;
+	/* highest valid XTALCAL value */
+	uint16_t xtalcalMax;
+	/* current XTALCAL value, persist after tda5340AfcFeed returned true */
+	uint16_t xtalcal;
+
+	/* private data, do not touch */
+	/* running average, scaled by 2^shift, seeded by the first frame */
+	int32_t sum;
+	uint16_t frames;
+} tda5340Afc;
+
+void tda5340AfcInit (tda5340Afc * const afc, const uint16_t xtalcal);
+bool tda5340AfcFeed (tda5340Afc * const afc, const int8_t offset);
+int16_t tda5340AfcOffset (const tda5340Afc * const afc);
@@ -0,0 +1,199 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <string.h>
+
+#include "tda5340_ber.h"
+#include "tda5340_frame.h"
+#include "util.h"
+
+/*	Little endian word access, see tda5340_frame.c
+ */
+static uint32_t load32 (const uint8_t * const p) {
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static uint16_t pn9Advance (uint16_t pos, const uint16_t bits) {
+	pos += bits;
+	return pos >= TDA_PN9_PERIOD ? pos - TDA_PN9_PERIOD : pos;
+}
+
+void tda5340BerInit (tda5340Ber * const ber, const uint8_t syncErrors,
+		const uint8_t burstGap, const uint16_t interval) {
+	assert (ber != NULL);
+	assert (interval > 0);
+
+	memset (ber, 0, sizeof (*ber));
+	ber->syncErrors = syncErrors;
+	ber->burstGap = burstGap;
+	ber->interval = interval;
+	ber->rssiMin = UINT8_MAX;
+}
+
+/*	Fill len bytes of data with the PN9 sequence, starting at bit pos.
+ *	Returns the position to continue from with the next frame.
+ */
+uint16_t tda5340BerFill (uint8_t * const data, const size_t len, uint16_t pos) {
+	assert (data != NULL || len == 0);
+	assert (pos < TDA_PN9_PERIOD);
+
+	for (size_t i = 0; i < len; i++) {
+		data[i] = tda5340Pn9 (pos);
+		pos = pn9Advance (pos, 8);
+	}
+	return pos;
+}
+
+/*	Position of word within the sequence, closest match by hamming distance
+ */
+static uint16_t locate (const uint32_t word, uint8_t * const distance) {
+	uint16_t best = 0;
+	uint8_t bestDistance = 33;
+	for (uint16_t pos = 0; pos < TDA_PN9_PERIOD; pos++) {
+		const uint8_t d = __builtin_popcount (word ^ tda5340Pn9 (pos));
+		if (d < bestDistance) {
+			best = pos;
+			bestDistance = d;
+			if (d == 0) {
+				break;
+			}
+		}
+	}
+	*distance = bestDistance;
+	return best;
+}
+
+static void historyPush (tda5340Ber * const ber) {
+	tda5340BerSample * const s = &ber->history[(ber->historyHead +
+			ber->historyCount) % TDA_BER_HISTORY];
+	s->bits = ber->sampleBits;
+	s->errors = ber->sampleErrors;
+	s->rssi = ber->sampleRssi / ber->sampleBlocks;
+	if (ber->historyCount < TDA_BER_HISTORY) {
+		ber->historyCount++;
+	} else {
+		ber->historyHead = (ber->historyHead + 1) % TDA_BER_HISTORY;
+	}
+
+	ber->sampleBlocks = 0;
+	ber->sampleBits = 0;
+	ber->sampleErrors = 0;
+	ber->sampleRssi = 0;
+}
+
+/*	Compare a received block (lsb first, like the fifo) against the sequence.
+ *	rssi is the block’s signal strength, e.g. RSSIPRX. Returns false if the
+ *	block could not be located.
+ */
+bool tda5340BerFeed (tda5340Ber * const ber, const uint8_t * const data,
+		const size_t bits, const uint8_t rssi) {
+	assert (ber != NULL);
+	assert (data != NULL || bits == 0);
+
+	if (bits < 32) {
+		ber->lost++;
+		return false;
+	}
+	/* the full search costs up to TDA_PN9_PERIOD compares, only do it when
+	 * the block does not follow the previous one */
+	const uint32_t head = load32 (data);
+	uint16_t pos = ber->expected;
+	if (!ber->sync ||
+			__builtin_popcount (head ^ tda5340Pn9 (pos)) > ber->syncErrors) {
+		uint8_t distance;
+		pos = locate (head, &distance);
+		if (distance > ber->syncErrors) {
+			ber->sync = false;
+			ber->lost++;
+			return false;
+		}
+	}
+	ber->sync = true;
+	ber->expected = pn9Advance (pos, bits % TDA_PN9_PERIOD);
+
+	uint32_t errors = 0;
+	/* bit offsets of the current burst’s first and last error */
+	size_t first = 0, last = 0;
+	bool burst = false;
+	for (size_t off = 0; off < bits; off += 32) {
+		const size_t rest = bits - off;
+		uint32_t x;
+		if (rest >= 32) {
+			x = load32 (&data[off/8]) ^ tda5340Pn9 (pos);
+		} else {
+			/* partial last word, only the valid bytes are touched */
+			uint32_t word = 0;
+			for (size_t i = 0; i < (rest + 7)/8; i++) {
+				word |= (uint32_t) data[off/8 + i] << (8*i);
+			}
+			x = (word ^ tda5340Pn9 (pos)) & ((UINT32_C (1) << rest) - 1);
+		}
+		pos = pn9Advance (pos, 32);
+
+		if (x == 0) {
+			continue;
+		}
+		errors += __builtin_popcount (x);
+
+		const size_t lo = off + __builtin_ctz (x), hi = off + 31 - __builtin_clz (x);
+		if (burst && lo - last > 32u*ber->burstGap) {
+			ber->burstMax = max (ber->burstMax, last - first + 1);
+			burst = false;
+		}
+		if (!burst) {
+			ber->bursts++;
+			first = lo;
+			burst = true;
+		}
+		last = hi;
+	}
+	if (burst) {
+		ber->burstMax = max (ber->burstMax, last - first + 1);
+	}
+
+	ber->blocks++;
+	ber->bits += bits;
+	ber->errors += errors;
+	ber->rssiMin = min (ber->rssiMin, rssi);
+	ber->rssiMax = max (ber->rssiMax, rssi);
+
+	ber->sampleBits += bits;
+	ber->sampleErrors += errors;
+	ber->sampleRssi += rssi;
+	if (++ber->sampleBlocks >= ber->interval) {
+		historyPush (ber);
+	}
+
+	return true;
+}
+
+/*	Bit error rate in parts per million
+ */
+uint32_t tda5340BerPpm (const tda5340Ber * const ber) {
+	assert (ber != NULL);
+
+	if (ber->bits == 0) {
+		return 0;
+	}
+	return (uint64_t) ber->errors * 1000000 / ber->bits;
+}
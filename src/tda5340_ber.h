@@ -0,0 +1,82 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Bit error rate test, independent of the hardware. The transmitter sends
+ * the PN9 sequence (same as whitening) continuously, split into frames, see
+ * tda5340BerFill. The receiver locates each received block within the
+ * sequence by its first word, so lost frames or a transmitter starting
+ * anywhere do not matter, and compares it a word at a time. Once in sync it
+ * expects every block to continue where the previous one ended and only
+ * searches the whole sequence again if that does not match. */
+
+/* number of history samples */
+#define TDA_BER_HISTORY 16
+
+typedef struct {
+	uint32_t bits, errors;
+	/* average RSSI */
+	uint8_t rssi;
+} tda5340BerSample;
+
+typedef struct {
+	/* bit errors allowed in the first word of a block for locating it, the
+	 * block is counted as lost otherwise */
+	uint8_t syncErrors;
+	/* error-free words separating two bursts */
+	uint8_t burstGap;
+	/* blocks per history sample */
+	uint16_t interval;
+
+	/* results */
+	uint32_t bits, errors;
+	/* blocks compared and blocks that could not be located */
+	uint32_t blocks, lost;
+	/* number of error bursts and the longest one, from first to last error,
+	 * in bits */
+	uint32_t bursts;
+	uint16_t burstMax;
+	uint8_t rssiMin, rssiMax;
+	/* ring of samples over time, head is the oldest one once full */
+	tda5340BerSample history[TDA_BER_HISTORY];
+	uint8_t historyHead, historyCount;
+
+	/* private data, do not touch */
+	/* sample in progress */
+	uint16_t sampleBlocks;
+	uint32_t sampleBits, sampleErrors, sampleRssi;
+	/* sequence position the next block should start at, if in sync */
+	bool sync;
+	uint16_t expected;
+} tda5340Ber;
+
+void tda5340BerInit (tda5340Ber * const ber, const uint8_t syncErrors,
+		const uint8_t burstGap, const uint16_t interval);
+uint16_t tda5340BerFill (uint8_t * const data, const size_t len, uint16_t pos);
+bool tda5340BerFeed (tda5340Ber * const ber, const uint8_t * const data,
+		const size_t bits, const uint8_t rssi);
+uint32_t tda5340BerPpm (const tda5340Ber * const ber);
@@ -0,0 +1,54 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <stddef.h>
+
+#include "tda5340_cca.h"
+
+void tda5340CcaInit (tda5340Cca * const cca, const uint8_t samples,
+		const uint8_t threshold) {
+	assert (cca != NULL);
+	assert (samples > 0);
+
+	cca->samples = samples;
+	cca->threshold = threshold;
+	cca->taken = 0;
+	cca->peak = 0;
+}
+
+/*	Feed one RSSI sample. Any sample at or above the threshold marks the
+ *	channel busy immediately, no need to wait for the remaining ones.
+ */
+tda5340CcaStatus tda5340CcaFeed (tda5340Cca * const cca, const uint8_t rssi) {
+	assert (cca != NULL);
+	assert (cca->taken < cca->samples);
+
+	++cca->taken;
+	if (rssi > cca->peak) {
+		cca->peak = rssi;
+	}
+	if (rssi >= cca->threshold) {
+		return TDA_CCA_BUSY;
+	}
+	return cca->taken == cca->samples ? TDA_CCA_CLEAR : TDA_CCA_PENDING;
+}
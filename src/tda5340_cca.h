@@ -0,0 +1,53 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+/* Clear channel assessment (listen before talk), independent of the
+ * hardware, so it can be fed from RSSIRX or a simulated source. */
+
+typedef enum {
+	/* more samples required */
+	TDA_CCA_PENDING = 0,
+	TDA_CCA_CLEAR,
+	TDA_CCA_BUSY,
+	/* could not switch mode or transmit */
+	TDA_CCA_ERROR,
+} tda5340CcaStatus;
+
+typedef struct {
+	/* number of samples below threshold required for a clear channel */
+	uint8_t samples;
+	/* channel is busy if any sample reaches this raw RSSI value */
+	uint8_t threshold;
+
+	/* private data, do not touch */
+	uint8_t taken;
+	/* highest rssi seen */
+	uint8_t peak;
+} tda5340Cca;
+
+void tda5340CcaInit (tda5340Cca * const cca, const uint8_t samples,
+		const uint8_t threshold);
+tda5340CcaStatus tda5340CcaFeed (tda5340Cca * const cca, const uint8_t rssi);
@@ -0,0 +1,71 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <stddef.h>
+
+#include "tda5340_div.h"
+
+/* success rate averaging weight is 1/2^SCORE_SHIFT */
+#define SCORE_SHIFT 3
+/* required advantage before a peer moves to another antenna */
+#define SCORE_HYSTERESIS 16
+
+void tda5340DivPeerInit (tda5340DivPeer * const peer) {
+	assert (peer != NULL);
+
+	peer->antenna = 0;
+	for (uint8_t i = 0; i < TDA_ANTENNAS; i++) {
+		/* unknown, neutral */
+		peer->score[i] = 128;
+	}
+}
+
+/*	Record the outcome of a frame exchanged with peer on antenna, either
+ *	received (ok if the CRC matched) or transmitted (ok if acknowledged).
+ *	stats is optional. Returns the antenna to use for peer from now on.
+ */
+uint8_t tda5340DivFeed (tda5340DivStats * const stats, tda5340DivPeer * const peer,
+		const uint8_t antenna, const bool tx, const bool ok) {
+	assert (peer != NULL);
+	assert (antenna < TDA_ANTENNAS && peer->antenna < TDA_ANTENNAS);
+
+	if (stats != NULL) {
+		tda5340DivCount * const c = tx ? &stats->tx[antenna] : &stats->rx[antenna];
+		c->frames++;
+		c->ok += ok;
+	}
+
+	const int16_t target = ok ? 255 : 0;
+	uint8_t * const score = &peer->score[antenna];
+	*score += (target - *score) / (1 << SCORE_SHIFT);
+
+	/* a peer sticks to its antenna unless another one does clearly better,
+	 * every move costs an ANTSW write */
+	for (uint8_t i = 0; i < TDA_ANTENNAS; i++) {
+		if (peer->score[i] > peer->score[peer->antenna] + SCORE_HYSTERESIS) {
+			peer->antenna = i;
+		}
+	}
+
+	return peer->antenna;
+}
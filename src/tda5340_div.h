@@ -0,0 +1,55 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Antenna diversity bookkeeping, independent of the hardware: success
+ * rates per antenna and the best antenna per peer, see tda5340Diversity for
+ * switching. */
+
+#define TDA_ANTENNAS 2
+
+typedef struct {
+	uint32_t frames, ok;
+} tda5340DivCount;
+
+/* per antenna success rates, received frames (CRC ok) and transmitted
+ * ones (acknowledged) */
+typedef struct {
+	tda5340DivCount rx[TDA_ANTENNAS], tx[TDA_ANTENNAS];
+} tda5340DivStats;
+
+typedef struct {
+	/* best antenna for the peer, use it for transmitting */
+	uint8_t antenna;
+
+	/* private data, do not touch */
+	/* running success rate per antenna, 255 is 100% */
+	uint8_t score[TDA_ANTENNAS];
+} tda5340DivPeer;
+
+void tda5340DivPeerInit (tda5340DivPeer * const peer);
+uint8_t tda5340DivFeed (tda5340DivStats * const stats, tda5340DivPeer * const peer,
+		const uint8_t antenna, const bool tx, const bool ok);
@@ -0,0 +1,113 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <assert.h>
+
+#include "tda5340_fec.h"
+
+#define FEC_CORRECTED (1 << 4)
+#define FEC_UNCORRECTABLE (1 << 5)
+/* codewords per interleaver group */
+#define FEC_GROUP 8
+
+/*	Transpose the 8x8 bit matrix in g (row = byte, column = bit), that is
+ *	bit j of byte i is swapped with bit i of byte j. Its own inverse.
+ */
+static void transpose8 (uint8_t * const g) {
+	uint32_t x = g[0] | g[1] << 8 | g[2] << 16 | (uint32_t) g[3] << 24;
+	uint32_t y = g[4] | g[5] << 8 | g[6] << 16 | (uint32_t) g[7] << 24;
+	uint32_t t;
+
+	/* 2x2 blocks, then 4x4 blocks within each half, then across halves */
+	t = (x ^ (x >> 7)) & 0x00aa00aa;
+	x ^= t ^ (t << 7);
+	t = (y ^ (y >> 7)) & 0x00aa00aa;
+	y ^= t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000cccc;
+	x ^= t ^ (t << 14);
+	t = (y ^ (y >> 14)) & 0x0000cccc;
+	y ^= t ^ (t << 14);
+	t = (x ^ (y << 4)) & 0xf0f0f0f0;
+	x ^= t;
+	y ^= t >> 4;
+
+	g[0] = x;
+	g[1] = x >> 8;
+	g[2] = x >> 16;
+	g[3] = x >> 24;
+	g[4] = y;
+	g[5] = y >> 8;
+	g[6] = y >> 16;
+	g[7] = y >> 24;
+}
+
+/*	Encode len bytes from src into 2*len bytes at dst. Works front to back,
+ *	so src may be the upper half of dst.
+ */
+void tda5340FecEncode (uint8_t * const dst, const uint8_t * const src,
+		const size_t len) {
+	assert (dst != NULL && src != NULL);
+	assert (src >= dst + len || src + len <= dst);
+
+	for (size_t i = 0; i < len; i++) {
+		const uint8_t v = src[i];
+		dst[2*i] = tda5340HammingEncTab[v & 0xf];
+		dst[2*i+1] = tda5340HammingEncTab[v >> 4];
+	}
+	for (size_t i = 0; i + FEC_GROUP <= 2*len; i += FEC_GROUP) {
+		transpose8 (&dst[i]);
+	}
+}
+
+/*	Decode 2*len bytes from src into len bytes at dst, dst may be src. src is
+ *	deinterleaved in place. Returns false if any codeword was uncorrectable,
+ *	counts are added to stats (optional).
+ */
+bool tda5340FecDecode (uint8_t * const dst, uint8_t * const src,
+		const size_t len, tda5340FecStats * const stats) {
+	assert (dst != NULL && src != NULL);
+
+	for (size_t i = 0; i + FEC_GROUP <= 2*len; i += FEC_GROUP) {
+		transpose8 (&src[i]);
+	}
+
+	uint8_t flags = 0;
+	uint32_t corrected = 0, uncorrectable = 0;
+	for (size_t i = 0; i < len; i++) {
+		const uint8_t lo = tda5340HammingDecTab[src[2*i]],
+				hi = tda5340HammingDecTab[src[2*i+1]];
+		const uint8_t f = lo | hi;
+		flags |= f;
+		if (f & (FEC_CORRECTED | FEC_UNCORRECTABLE)) {
+			corrected += ((lo & FEC_CORRECTED) != 0) + ((hi & FEC_CORRECTED) != 0);
+			uncorrectable += ((lo & FEC_UNCORRECTABLE) != 0) +
+					((hi & FEC_UNCORRECTABLE) != 0);
+		}
+		dst[i] = (lo & 0xf) | (hi & 0xf) << 4;
+	}
+	if (stats != NULL) {
+		stats->corrected += corrected;
+		stats->uncorrectable += uncorrectable;
+	}
+
+	return !(flags & FEC_UNCORRECTABLE);
+}
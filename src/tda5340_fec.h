@@ -0,0 +1,48 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Forward error correction for the raw bit path, independent of the
+ * hardware. Every nibble becomes an extended Hamming(8,4) codeword, which
+ * corrects one and detects two bit errors. Groups of eight codewords are
+ * bit-interleaved, so a burst of up to eight bits is spread across the
+ * group and stays correctable. A trailing group of less than eight
+ * codewords is not interleaved. */
+
+typedef struct {
+	/* codewords with one corrected error and uncorrectable ones */
+	uint32_t corrected, uncorrectable;
+} tda5340FecStats;
+
+/* see tda5340_frame_tab.c */
+extern const uint8_t tda5340HammingEncTab[16];
+extern const uint8_t tda5340HammingDecTab[256];
+
+void tda5340FecEncode (uint8_t * const dst, const uint8_t * const src,
+		const size_t len);
+bool tda5340FecDecode (uint8_t * const dst, uint8_t * const src,
+		const size_t len, tda5340FecStats * const stats);
@@ -0,0 +1,321 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <string.h>
+
+#include "tda5340_frame.h"
+
+/*	Little endian word access, buffers are not necessarily aligned
+ */
+static uint32_t load32 (const uint8_t * const p) {
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static void store32 (uint8_t * const p, const uint32_t v) {
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+/*	CRC-16/X-25 (reflected 0x8408, init and xorout 0xffff), slice-by-4
+ */
+uint16_t tda5340Crc16 (const uint8_t *data, size_t len) {
+	uint16_t crc = 0xffff;
+	for (; len >= 4; len -= 4, data += 4) {
+		const uint32_t x = crc ^ load32 (data);
+		crc = tda5340Crc16Tab[3][x & 0xff] ^ tda5340Crc16Tab[2][(x >> 8) & 0xff] ^
+				tda5340Crc16Tab[1][(x >> 16) & 0xff] ^ tda5340Crc16Tab[0][x >> 24];
+	}
+	while (len-- > 0) {
+		crc = (crc >> 8) ^ tda5340Crc16Tab[0][(crc ^ *data++) & 0xff];
+	}
+	return crc ^ 0xffff;
+}
+
+/*	CRC-32 (reflected 0xedb88320, init and xorout 0xffffffff), slice-by-4
+ */
+uint32_t tda5340Crc32 (const uint8_t *data, size_t len) {
+	uint32_t crc = 0xffffffff;
+	for (; len >= 4; len -= 4, data += 4) {
+		const uint32_t x = crc ^ load32 (data);
+		crc = tda5340Crc32Tab[3][x & 0xff] ^ tda5340Crc32Tab[2][(x >> 8) & 0xff] ^
+				tda5340Crc32Tab[1][(x >> 16) & 0xff] ^ tda5340Crc32Tab[0][x >> 24];
+	}
+	while (len-- > 0) {
+		crc = (crc >> 8) ^ tda5340Crc32Tab[0][(crc ^ *data++) & 0xff];
+	}
+	return crc ^ 0xffffffff;
+}
+
+/*	32 bits of the PN9 sequence, starting at bit pos (< TDA_PN9_PERIOD)
+ */
+uint32_t tda5340Pn9 (const uint16_t pos) {
+	assert (pos < TDA_PN9_PERIOD);
+
+	const uint8_t * const p = &tda5340Pn9Tab[pos >> 3];
+	const uint8_t shift = pos & 0x7;
+	/* two-step shift, shift by 32 is undefined */
+	return load32 (p) >> shift | (uint32_t) p[4] << (31 - shift) << 1;
+}
+
+/*	PN9 (x^9+x^5+1, seed 0x1ff) whitening in place, a word at a time. Its own
+ *	inverse.
+ */
+void tda5340Whiten (uint8_t * const data, const size_t len) {
+	assert (data != NULL || len == 0);
+
+	uint16_t pos = 0;
+	size_t i = 0;
+	for (; i + 4 <= len; i += 4) {
+		store32 (&data[i], load32 (&data[i]) ^ tda5340Pn9 (pos));
+		pos += 32;
+		if (pos >= TDA_PN9_PERIOD) {
+			pos -= TDA_PN9_PERIOD;
+		}
+	}
+	for (; i < len; i++) {
+		data[i] ^= tda5340Pn9 (pos);
+		pos += 8;
+		if (pos >= TDA_PN9_PERIOD) {
+			pos -= TDA_PN9_PERIOD;
+		}
+	}
+}
+
+/*	Insert a zero after every bit of a 16 bit value
+ */
+static uint32_t spread16 (uint32_t x) {
+	x = (x | x << 8) & 0x00ff00ff;
+	x = (x | x << 4) & 0x0f0f0f0f;
+	x = (x | x << 2) & 0x33333333;
+	x = (x | x << 1) & 0x55555555;
+	return x;
+}
+
+/*	Inverse of spread16, odd bits are dropped
+ */
+static uint32_t compact32 (uint32_t x) {
+	x &= 0x55555555;
+	x = (x | x >> 1) & 0x33333333;
+	x = (x | x >> 2) & 0x0f0f0f0f;
+	x = (x | x >> 4) & 0x00ff00ff;
+	x = (x | x >> 8) & 0x0000ffff;
+	return x;
+}
+
+/*	Manchester encode len bytes from src into 2*len bytes at dst, 1 is sent
+ *	as 10 and 0 as 01. Works front to back, so src may be the upper half of
+ *	dst.
+ */
+void tda5340ManchesterEncode (uint8_t * const dst, const uint8_t * const src,
+		const size_t len) {
+	assert (dst != NULL && src != NULL);
+	assert (src >= dst + len || src + len <= dst);
+
+	size_t i = 0;
+	for (; i + 2 <= len; i += 2) {
+		const uint32_t v = src[i] | src[i+1] << 8;
+		store32 (&dst[2*i], spread16 (v) | spread16 (~v & 0xffff) << 1);
+	}
+	if (i < len) {
+		const uint32_t v = src[i];
+		const uint32_t e = spread16 (v) | spread16 (~v & 0xff) << 1;
+		dst[2*i] = e;
+		dst[2*i+1] = e >> 8;
+	}
+}
+
+/*	Decode 2*len bytes from src into len bytes at dst, dst may be src. Returns
+ *	false if any chip pair is invalid (00 or 11).
+ */
+bool tda5340ManchesterDecode (uint8_t * const dst, const uint8_t * const src,
+		const size_t len) {
+	assert (dst != NULL && src != NULL);
+
+	bool valid = true;
+	size_t i = 0;
+	for (; i + 2 <= len; i += 2) {
+		const uint32_t e = load32 (&src[2*i]);
+		valid &= ((e ^ e >> 1) & 0x55555555) == 0x55555555;
+		const uint32_t v = compact32 (e);
+		dst[i] = v;
+		dst[i+1] = v >> 8;
+	}
+	if (i < len) {
+		const uint32_t e = src[2*i] | src[2*i+1] << 8;
+		valid &= ((e ^ e >> 1) & 0x5555) == 0x5555;
+		dst[i] = compact32 (e);
+	}
+	return valid;
+}
+
+static size_t crcLength (const tda5340FrameCrc crc) {
+	switch (crc) {
+		case TDA_FRAME_CRC16:
+			return 2;
+
+		case TDA_FRAME_CRC32:
+			return 4;
+
+		default:
+			return 0;
+	}
+}
+
+/*	FEC codes four bytes (a whole interleaver group) at a time
+ */
+static size_t padLength (const tda5340Frame * const f, const size_t body) {
+	return f->fec ? (body + 3) & ~(size_t) 3 : body;
+}
+
+/*	Build a frame with payload into buf, which can hold size bytes. Returns
+ *	the frame length in bits (for tda5340FifoWrite), 0 if the coded frame
+ *	exceeds size, see tda5340_frame.h for the payload limits.
+ */
+size_t tda5340FrameBuild (const tda5340Frame * const f,
+		const uint8_t * const payload, const uint8_t len, uint8_t * const buf,
+		const size_t size) {
+	assert (f != NULL && buf != NULL);
+	assert (f->header != NULL || f->headerLen == 0);
+	assert (payload != NULL || len == 0);
+
+	const size_t body = 1 + len + crcLength (f->crc);
+	const size_t padded = padLength (f, body);
+	const size_t coded = padded * (f->fec ? 2 : 1) * (f->manchester ? 2 : 1);
+	if (f->headerLen + coded > size) {
+		return 0;
+	}
+
+	memcpy (buf, f->header, f->headerLen);
+	uint8_t * const out = &buf[f->headerLen];
+	/* assemble the body at the end, each coding stage expands it towards
+	 * the front */
+	uint8_t *b = &out[coded - padded];
+	b[0] = len;
+	memcpy (&b[1], payload, len);
+	switch (f->crc) {
+		case TDA_FRAME_CRC16: {
+			const uint16_t crc = tda5340Crc16 (b, 1 + len);
+			b[1+len] = crc;
+			b[2+len] = crc >> 8;
+			break;
+		}
+
+		case TDA_FRAME_CRC32:
+			store32 (&b[1+len], tda5340Crc32 (b, 1 + len));
+			break;
+
+		default:
+			break;
+	}
+	memset (&b[body], 0, padded - body);
+	if (f->whiten) {
+		tda5340Whiten (b, padded);
+	}
+	size_t n = padded;
+	if (f->fec) {
+		uint8_t * const fec = &out[coded - 2*n];
+		tda5340FecEncode (fec, b, n);
+		b = fec;
+		n *= 2;
+	}
+	if (f->manchester) {
+		tda5340ManchesterEncode (out, b, n);
+	}
+
+	return (f->headerLen + coded)*8;
+}
+
+/*	Validate a received frame (without header) of bits in buf, decoding it in
+ *	place. payload points into buf afterwards.
+ */
+tda5340FrameStatus tda5340FrameParse (const tda5340Frame * const f,
+		uint8_t * const buf, const size_t bits, const uint8_t ** const payload,
+		uint8_t * const len) {
+	assert (f != NULL && buf != NULL);
+	assert (payload != NULL && len != NULL);
+
+	/* decodable body bytes */
+	const size_t fecScale = f->fec ? 2 : 1;
+	const size_t avail = bits/8/fecScale/(f->manchester ? 2 : 1);
+	/* the length byte tells how much to decode. Decode a copy of the first
+	 * byte (or FEC group) to get it */
+	const size_t peek = padLength (f, 1);
+	if (avail < peek) {
+		return TDA_FRAME_SHORT;
+	}
+	/* with FEC Manchester violations are left to the Hamming decoder, the
+	 * first chip of a pair is the data bit */
+	uint8_t first[8];
+	if (f->manchester) {
+		if (!tda5340ManchesterDecode (first, buf, peek*fecScale) && !f->fec) {
+			return TDA_FRAME_CODING;
+		}
+	} else {
+		memcpy (first, buf, peek*fecScale);
+	}
+	if (f->fec && !tda5340FecDecode (first, first, peek, NULL)) {
+		return TDA_FRAME_UNCORRECTABLE;
+	}
+	uint8_t n = first[0];
+	if (f->whiten) {
+		n ^= tda5340Pn9Tab[0];
+	}
+	const size_t body = 1 + n + crcLength (f->crc);
+	const size_t padded = padLength (f, body);
+	if (padded > avail) {
+		return TDA_FRAME_SHORT;
+	}
+
+	if (f->manchester && !tda5340ManchesterDecode (buf, buf, padded*fecScale) &&
+			!f->fec) {
+		return TDA_FRAME_CODING;
+	}
+	if (f->fec && !tda5340FecDecode (buf, buf, padded, f->fecStats)) {
+		return TDA_FRAME_UNCORRECTABLE;
+	}
+	if (f->whiten) {
+		tda5340Whiten (buf, padded);
+	}
+	bool match = true;
+	switch (f->crc) {
+		case TDA_FRAME_CRC16:
+			match = tda5340Crc16 (buf, 1 + n) == (buf[1+n] | buf[2+n] << 8);
+			break;
+
+		case TDA_FRAME_CRC32:
+			match = tda5340Crc32 (buf, 1 + n) == load32 (&buf[1+n]);
+			break;
+
+		default:
+			break;
+	}
+	if (!match) {
+		return TDA_FRAME_CRC_MISMATCH;
+	}
+
+	*payload = &buf[1];
+	*len = n;
+	return TDA_FRAME_OK;
+}
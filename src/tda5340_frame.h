@@ -0,0 +1,103 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tda5340_fec.h"
+
+/* Optional packet framing for the raw bit fifo, independent of the hardware.
+ * A frame is the raw header (preamble/sync word, transmit only, the TDA
+ * strips it on reception), followed by the body: length byte, payload and
+ * CRC (little endian), optionally PN9 whitened, FEC coded (padded to whole
+ * interleaver groups) and Manchester coded, in that order. Frames are built
+ * right into the fifo write buffer and parsed in place from the receive
+ * buffer, both lsb first, like the fifo. See tools/tda5340fecbench.c for a
+ * host check and benchmark.
+ *
+ * Frames are not split across fifo fills, so a frame for tda5340FifoWrite
+ * must be built with size TDA_TXFIFO_SIZE/8 (32 bytes), tda5340FrameBuild
+ * rejects larger ones. With an h byte header and a c byte CRC (0, 2 or 4)
+ * the payload is at most
+ *
+ *	no coding, whitening       31 - h - c
+ *	Manchester                 (32 - h)/2 - 1 - c
+ *	FEC                        4*((32 - h)/8) - 1 - c
+ *	FEC and Manchester         4*((32 - h)/16) - 1 - c
+ *
+ * bytes (integer division), e.g. 27, 12, 9 and 1 for a two byte header and
+ * CRC-16. tda5340TxQueuePush has less room, see there. */
+
+typedef enum {
+	TDA_FRAME_CRC_NONE = 0,
+	/* CRC-16/X-25 */
+	TDA_FRAME_CRC16,
+	/* CRC-32, IEEE 802.3 */
+	TDA_FRAME_CRC32,
+} tda5340FrameCrc;
+
+typedef enum {
+	TDA_FRAME_OK = 0,
+	/* fewer bits than the length byte announced */
+	TDA_FRAME_SHORT,
+	/* Manchester violation */
+	TDA_FRAME_CODING,
+	/* too many bit errors for FEC */
+	TDA_FRAME_UNCORRECTABLE,
+	TDA_FRAME_CRC_MISMATCH,
+} tda5340FrameStatus;
+
+typedef struct {
+	/* preamble and sync word, sent as is */
+	const uint8_t *header;
+	uint8_t headerLen;
+	tda5340FrameCrc crc;
+	bool whiten, fec, manchester;
+	/* optional, FEC statistics are added on reception */
+	tda5340FecStats *fecStats;
+} tda5340Frame;
+
+/* PN9 sequence length in bits */
+#define TDA_PN9_PERIOD 511
+
+/* see tda5340_frame_tab.c */
+extern const uint16_t tda5340Crc16Tab[4][256];
+extern const uint32_t tda5340Crc32Tab[4][256];
+extern const uint8_t tda5340Pn9Tab[68];
+
+uint16_t tda5340Crc16 (const uint8_t *data, size_t len);
+uint32_t tda5340Crc32 (const uint8_t *data, size_t len);
+uint32_t tda5340Pn9 (const uint16_t pos);
+void tda5340Whiten (uint8_t * const data, const size_t len);
+void tda5340ManchesterEncode (uint8_t * const dst, const uint8_t * const src,
+		const size_t len);
+bool tda5340ManchesterDecode (uint8_t * const dst, const uint8_t * const src,
+		const size_t len);
+size_t tda5340FrameBuild (const tda5340Frame * const f,
+		const uint8_t * const payload, const uint8_t len, uint8_t * const buf,
+		const size_t size);
+tda5340FrameStatus tda5340FrameParse (const tda5340Frame * const f,
+		uint8_t * const buf, const size_t bits, const uint8_t ** const payload,
+		uint8_t * const len);
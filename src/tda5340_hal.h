@@ -0,0 +1,49 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+/* Platform abstraction. Every platform provides the tda5340HalSpi type and
+ * the static inline hal* hooks below, so the driver compiles against them
+ * without call overhead:
+ *
+ * halSpiInit, halSpiTiming, halSpiTransfer, halSpiBitOrder: SPI bus, transfers
+ *	return false on failure
+ * halSsEnable, halSsDisable: chip select
+ * halPonInit, halPonSet: P_ON pin
+ * halNintInit, halNintFlag, halNintDisable, halNintEnable: NINT event
+ * halLock, halAtomicIncrement: lock-free primitives
+ * halTimeInit, halTimeTick, halTimeNow, HAL_TIME_RUNNING: μs timebase
+ * halTimerInit, halTimerArm, halTimerAck, halTimerStop, halTimerDisable,
+ *	halTimerEnable: one-shot scheduling timer
+ * halDelayus, halDebug: timing and debugging
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__linux__)
+#include "tda5340_hal_linux.h"
+#else
+#include "tda5340_hal_xmc.h"
+#endif
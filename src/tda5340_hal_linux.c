@@ -0,0 +1,160 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#if defined(__linux__)
+
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/epoll.h>
+
+#include "tda5340_hal.h"
+
+/*	Request a single gpio line, returns its fd or -1
+ */
+static int lineRequest (const int chip, const uint32_t offset,
+		const uint64_t flags, const bool high) {
+	struct gpio_v2_line_request req;
+	memset (&req, 0, sizeof (req));
+	req.offsets[0] = offset;
+	req.num_lines = 1;
+	strncpy (req.consumer, "prettylewis", sizeof (req.consumer)-1);
+	req.config.flags = flags;
+	if (flags & GPIO_V2_LINE_FLAG_OUTPUT) {
+		req.config.num_attrs = 1;
+		req.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+		req.config.attrs[0].attr.values = high ? 1 : 0;
+		req.config.attrs[0].mask = 1;
+	}
+	if (ioctl (chip, GPIO_V2_GET_LINE_IOCTL, &req) == -1) {
+		return -1;
+	}
+	return req.fd;
+}
+
+/*	Open and set up spidev, request gpio lines. P_ON starts low (TDA off),
+ *	chip select deasserted.
+ */
+bool tda5340HalLinuxOpen (tda5340HalSpi * const spi) {
+	assert (spi != NULL);
+	assert (spi->spidev != NULL && spi->gpiochip != NULL);
+
+	spi->csLine = spi->ponLine = spi->nintLine = spi->epoll = -1;
+	spi->timerArmed = false;
+	spi->spi = open (spi->spidev, O_RDWR | O_CLOEXEC);
+	int chip = open (spi->gpiochip, O_RDWR | O_CLOEXEC);
+	if (spi->spi == -1 || chip == -1) {
+		goto fail;
+	}
+
+	/* data is set on falling and sampled on rising edge, see XMC port */
+	const uint32_t mode = SPI_MODE_0 | SPI_NO_CS;
+	const uint8_t bits = 8;
+	if (ioctl (spi->spi, SPI_IOC_WR_MODE32, &mode) == -1 ||
+			ioctl (spi->spi, SPI_IOC_WR_BITS_PER_WORD, &bits) == -1) {
+		goto fail;
+	}
+
+	spi->csLine = lineRequest (chip, spi->cs, GPIO_V2_LINE_FLAG_OUTPUT, true);
+	spi->ponLine = lineRequest (chip, spi->pon, GPIO_V2_LINE_FLAG_OUTPUT, false);
+	spi->nintLine = lineRequest (chip, spi->nint, GPIO_V2_LINE_FLAG_INPUT |
+			GPIO_V2_LINE_FLAG_EDGE_FALLING, false);
+	close (chip);
+	chip = -1;
+	if (spi->csLine == -1 || spi->ponLine == -1 || spi->nintLine == -1) {
+		goto fail;
+	}
+
+	spi->epoll = epoll_create1 (EPOLL_CLOEXEC);
+	struct epoll_event ev = {.events = EPOLLIN, .data.fd = spi->nintLine};
+	if (spi->epoll == -1 ||
+			epoll_ctl (spi->epoll, EPOLL_CTL_ADD, spi->nintLine, &ev) == -1) {
+		goto fail;
+	}
+	return true;
+
+fail:
+	if (chip != -1) {
+		close (chip);
+	}
+	tda5340HalLinuxClose (spi);
+	return false;
+}
+
+void tda5340HalLinuxClose (tda5340HalSpi * const spi) {
+	const int fds[] = {spi->spi, spi->csLine, spi->ponLine, spi->nintLine,
+			spi->epoll};
+	for (size_t i = 0; i < sizeof (fds)/sizeof (*fds); i++) {
+		if (fds[i] != -1) {
+			close (fds[i]);
+		}
+	}
+	spi->spi = spi->csLine = spi->ponLine = spi->nintLine = spi->epoll = -1;
+}
+
+/*	Wait up to timeout ms (-1 is forever) for a falling edge on NINT or the
+ *	scheduling timer. Returns 1 if an edge occured (call tda5340IrqHandle
+ *	now), 2 if the timer expired (call tda5340TimerHandle), 0 on timeout and
+ *	-1 on error.
+ */
+int tda5340HalLinuxWait (tda5340HalSpi * const spi, int timeout) {
+	/* the timer deadline, not the caller’s, limits the wait */
+	bool timerDue = false;
+	if (spi->timerArmed) {
+		const int32_t remaining = spi->timerAt - tda5340HalLinuxClock ();
+		const int ms = remaining > 0 ? remaining / 1000 : 0;
+		if (timeout == -1 || ms <= timeout) {
+			timeout = ms;
+			timerDue = true;
+		}
+	}
+
+	struct epoll_event ev;
+	const int ret = epoll_wait (spi->epoll, &ev, 1, timeout);
+	if (ret < 0) {
+		return ret;
+	} else if (ret == 0) {
+		if (timerDue && (int32_t) (spi->timerAt - tda5340HalLinuxClock ()) < 1000) {
+			/* epoll has ms resolution, spin for the rest */
+			while ((int32_t) (spi->timerAt - tda5340HalLinuxClock ()) > 0);
+			return 2;
+		}
+		return 0;
+	}
+	/* consume edge events */
+	struct gpio_v2_line_event events[16];
+	if (read (spi->nintLine, events, sizeof (events)) == -1) {
+		return -1;
+	}
+	return 1;
+}
+
+/*	Monotonic μs clock for tda5340Ctx.clock
+ */
+uint32_t tda5340HalLinuxClock (void) {
+	struct timespec t;
+	clock_gettime (CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+#endif /* __linux__ */
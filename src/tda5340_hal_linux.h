@@ -0,0 +1,235 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+/* Linux userspace platform, do not include directly, see tda5340_hal.h
+ *
+ * The bus is a spidev device, chip select, P_ON and NINT are gpiochip
+ * character device lines. Fill in the configuration part of tda5340HalSpi,
+ * call tda5340HalLinuxOpen and point tda5340Ctx.spi to it before
+ * tda5340Init. There is no interrupt context: wait for NINT with
+ * tda5340HalLinuxWait and call tda5340IrqHandle (or tda5340TimerHandle) from
+ * the same thread that uses the driver. */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+#include <linux/spi/spidev.h>
+
+typedef struct {
+	/* configuration, e.g. /dev/spidev0.0 and /dev/gpiochip0 */
+	const char *spidev, *gpiochip;
+	/* line offsets on gpiochip, chip select is driven manually, so it stays
+	 * asserted across transfers */
+	uint32_t cs, pon, nint;
+
+	/* private data, do not touch */
+	int spi, csLine, ponLine, nintLine, epoll;
+	uint32_t speed;
+	bool lsbFirst;
+	/* scheduling timer deadline, see tda5340HalLinuxWait */
+	uint32_t timerAt;
+	bool timerArmed;
+} tda5340HalSpi;
+
+#define halDebug(f, ...) fprintf (stderr, f, ##__VA_ARGS__)
+
+bool tda5340HalLinuxOpen (tda5340HalSpi * const spi);
+void tda5340HalLinuxClose (tda5340HalSpi * const spi);
+int tda5340HalLinuxWait (tda5340HalSpi * const spi, int timeout);
+uint32_t tda5340HalLinuxClock (void);
+
+static inline void halLineSet (const int line, const bool high) {
+	struct gpio_v2_line_values v = {.bits = high ? 1 : 0, .mask = 1};
+	if (ioctl (line, GPIO_V2_LINE_SET_VALUES_IOCTL, &v) == -1) {
+		halDebug ("gpio set failed: %s\n", strerror (errno));
+	}
+}
+
+/*	Mode and word size are set up by tda5340HalLinuxOpen, the speed is
+ *	passed with every transfer as well
+ */
+static inline void halSpiInit (tda5340HalSpi * const spi, const uint32_t baudrate) {
+	if (ioctl (spi->spi, SPI_IOC_WR_MAX_SPEED_HZ, &baudrate) == -1) {
+		halDebug ("spi speed %u failed: %s\n", baudrate, strerror (errno));
+	}
+	spi->speed = baudrate;
+	spi->lsbFirst = false;
+}
+
+/*	spidev always samples on the rising edge, which is the XMC port’s delayed
+ *	shift clock, the undelayed setting is not available
+ */
+static inline bool halSpiTiming (tda5340HalSpi * const spi,
+		const uint32_t baudrate, const bool delay) {
+	if (!delay || ioctl (spi->spi, SPI_IOC_WR_MAX_SPEED_HZ, &baudrate) != 0) {
+		return false;
+	}
+	spi->speed = baudrate;
+	return true;
+}
+
+static inline uint8_t halReverse (uint8_t b) {
+	b = (b & 0xf0) >> 4 | (b & 0x0f) << 4;
+	b = (b & 0xcc) >> 2 | (b & 0x33) << 2;
+	b = (b & 0xaa) >> 1 | (b & 0x55) << 1;
+	return b;
+}
+
+/*	Full-duplex burst transfer of len bytes, rx may be NULL. Most controllers
+ *	cannot switch bit order per transfer, so lsb first is done in software.
+ *	Returns false if the transfer failed, rx is zeroed then.
+ */
+static inline bool halSpiTransfer (tda5340HalSpi * const spi,
+		const uint8_t * const tx, uint8_t * const rx, const size_t len) {
+	uint8_t txbuf[64], rxbuf[64];
+
+	for (size_t off = 0; off < len; off += sizeof (txbuf)) {
+		const size_t n = len - off < sizeof (txbuf) ? len - off : sizeof (txbuf);
+		for (size_t i = 0; i < n; i++) {
+			const uint8_t b = tx != NULL ? tx[off+i] : 0x00;
+			txbuf[i] = spi->lsbFirst ? halReverse (b) : b;
+		}
+		struct spi_ioc_transfer t = {
+				.tx_buf = (uintptr_t) txbuf,
+				.rx_buf = (uintptr_t) rxbuf,
+				.len = n,
+				.speed_hz = spi->speed,
+				.bits_per_word = 8,
+				};
+		if (ioctl (spi->spi, SPI_IOC_MESSAGE(1), &t) < 0) {
+			halDebug ("spi transfer failed: %s\n", strerror (errno));
+			if (rx != NULL) {
+				memset (rx, 0, len);
+			}
+			return false;
+		}
+		if (rx != NULL) {
+			for (size_t i = 0; i < n; i++) {
+				rx[off+i] = spi->lsbFirst ? halReverse (rxbuf[i]) : rxbuf[i];
+			}
+		}
+	}
+	return true;
+}
+
+static inline void halSpiBitOrder (tda5340HalSpi * const spi, const bool lsbFirst) {
+	spi->lsbFirst = lsbFirst;
+}
+
+/* chip select is low-active */
+static inline void halSsEnable (tda5340HalSpi * const spi) {
+	halLineSet (spi->csLine, false);
+}
+
+static inline void halSsDisable (tda5340HalSpi * const spi) {
+	halLineSet (spi->csLine, true);
+}
+
+static inline void halPonInit (tda5340HalSpi * const spi) {
+	/* requested as output (low) by tda5340HalLinuxOpen */
+}
+
+static inline void halPonSet (tda5340HalSpi * const spi, const bool high) {
+	halLineSet (spi->ponLine, high);
+}
+
+static inline void halNintInit (tda5340HalSpi * const spi, const uint32_t priority) {
+	/* edge detection is set up by tda5340HalLinuxOpen */
+}
+
+/*	NINT is low
+ */
+static inline bool halNintFlag (tda5340HalSpi * const spi) {
+	struct gpio_v2_line_values v = {.bits = 0, .mask = 1};
+	if (ioctl (spi->nintLine, GPIO_V2_LINE_GET_VALUES_IOCTL, &v) == -1) {
+		halDebug ("gpio get failed: %s\n", strerror (errno));
+		return false;
+	}
+	return (v.bits & 1) == 0;
+}
+
+/* NINT is handled synchronously by the event loop, nothing to mask */
+static inline void halNintDisable (tda5340HalSpi * const spi) {
+}
+
+static inline void halNintEnable (tda5340HalSpi * const spi) {
+}
+
+/*	The scheduling timer is a deadline for tda5340HalLinuxWait
+ */
+static inline void halTimerInit (tda5340HalSpi * const spi, const uint32_t priority) {
+	spi->timerArmed = false;
+}
+
+static inline void halTimerArm (tda5340HalSpi * const spi, const uint32_t delay) {
+	spi->timerAt = tda5340HalLinuxClock () + delay;
+	spi->timerArmed = true;
+}
+
+static inline void halTimerAck (tda5340HalSpi * const spi) {
+	spi->timerArmed = false;
+}
+
+static inline void halTimerStop (tda5340HalSpi * const spi) {
+	spi->timerArmed = false;
+}
+
+static inline void halTimerDisable (tda5340HalSpi * const spi) {
+}
+
+static inline void halTimerEnable (tda5340HalSpi * const spi) {
+}
+
+static inline bool halLock (volatile uint8_t * const lock) {
+	return __sync_bool_compare_and_swap (lock, 0, 1);
+}
+
+static inline uint32_t halAtomicIncrement (volatile uint32_t * const v) {
+	return __sync_fetch_and_add (v, 1);
+}
+
+/*	CLOCK_MONOTONIC needs no setup and no tick
+ */
+#define HAL_TIME_RUNNING true
+
+static inline void halTimeInit (const bool configure) {
+	(void) configure;
+}
+
+static inline void halTimeTick (void) {
+}
+
+static inline uint32_t halTimeNow (void) {
+	return tda5340HalLinuxClock ();
+}
+
+static inline void halDelayus (const uint32_t delay) {
+	const struct timespec t = {.tv_sec = delay / 1000000,
+			.tv_nsec = (delay % 1000000) * 1000};
+	clock_nanosleep (CLOCK_MONOTONIC, 0, &t, NULL);
+}
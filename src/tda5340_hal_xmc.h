@@ -0,0 +1,432 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+/* Infineon XMC1100/XMC4500 platform, do not include directly, see
+ * tda5340_hal.h */
+
+#include <xmc_ccu4.h>
+#include <xmc_eru.h>
+#include <xmc_gpio.h>
+#include <xmc_scu.h>
+#include <xmc_spi.h>
+
+#include <SEGGER_RTT.h>
+
+/* pin config */
+#if UC_SERIES == XMC11
+	/* for csmTDA */
+	#define TDAPON  P0_5 /* P_ON */
+	#define TDANINT P2_6 /* PP2 <-> ERU0.2A1 */
+
+	/* spi pins, usic 1, channel 1 */
+	#define SPI_ALT XMC_GPIO_MODE_OUTPUT_PUSH_PULL_ALT6
+	#define SPI_MISO P0_15 /* SDO, DX0D */
+	#define SPI_INPUTSRC USIC0_C0_DX0_P0_15
+	#define SPI_MOSI P0_14 /* SDI, DOUT0 */
+	#define SPI_SS   P0_9 /* NCS, SELO0 */
+	#define SPI_SCLK P0_8 /* SCLK, SCLKOUT */
+
+	/* ETL config */
+	#define ETL ERU0_ETL2
+	#define ETL_SRCAB XMC_ERU_ETL_SOURCE_A
+	#define ETL_SRCPIN .input_a = ERU0_ETL2_INPUTA_P2_6
+#elif UC_SERIES == XMC45
+	/* We cannot use P1.14 or P1.15 here. These are used for the buttons. Yes, I
+	 * tried that. */
+	#define TDAPON  P0_3 /* P_ON */
+	#define TDANINT P0_2 /* PP2 <-> ERU0.3B3, that is ERU0, channel 3, input B, signal 3 */
+
+	/* spi pins, usic 1, channel 1 */
+	#define SPI_ALT XMC_GPIO_MODE_OUTPUT_PUSH_PULL_ALT2
+	#define SPI_MISO P0_0 /* SDO, DX0D */
+	#define SPI_INPUTSRC USIC1_C1_DX0_P0_0
+	#define SPI_MOSI P0_1 /* SDI, DOUT0 */
+	#define SPI_SS   P0_9 /* NCS, SELO0 */
+	#define SPI_SCLK P0_10 /* SCLK, SCLKOUT */
+
+	/* ETL config */
+	#define ETL ERU0_ETL3
+	#define ETL_SRCAB XMC_ERU_ETL_SOURCE_B
+	#define ETL_SRCPIN .input_b = ERU0_ETL3_INPUTB_P0_2
+#else
+	#error "unknown uc"
+#endif
+
+/* common */
+/* interrupt, depends on OGU used, make sure you change TDA5350IRQHANDLER
+ * too */
+#define INTERRUPT ERU0_3_IRQn
+/* select trigger channel */
+#define ETL_CHANNEL XMC_ERU_ETL_OUTPUT_TRIGGER_CHANNEL3
+/* OGU */
+#define OGU ERU0_OGU3
+
+/* IRQ handler name */
+#define TDA5350IRQHANDLER ERU0_3_IRQHandler
+/* timebase handler name */
+#define TDA5340TIMEHANDLER SysTick_Handler
+
+/* scheduling timer, CCU4 module 0, slice 0, see tda5340TimerHandle */
+#define TIMER_MODULE CCU40
+#define TIMER_SLICE CCU40_CC40
+#define TIMER_INTERRUPT CCU40_0_IRQn
+#define TDA5340TIMERHANDLER CCU40_0_IRQHandler
+
+typedef XMC_USIC_CH_t tda5340HalSpi;
+
+/* timebase ticks, tick period and SysTick clock, see tda5340_hal_xmc.c */
+extern volatile uint32_t halTimeTicks;
+extern uint32_t halTimeTickUs, halTimeCyclesPerUs;
+
+/* SysTick is only configured by tda5340TimeInit */
+#define HAL_TIME_RUNNING false
+
+//#define halDebug(...)
+#define halDebug(f, ...) SEGGER_RTT_printf(0, f, ##__VA_ARGS__)
+
+static inline void halSpiInit (tda5340HalSpi * const spi, const uint32_t baudrate) {
+	XMC_SPI_CH_CONFIG_t config = {
+		.baudrate = baudrate,
+		.bus_mode = XMC_SPI_CH_BUS_MODE_MASTER,
+		.selo_inversion = XMC_SPI_CH_SLAVE_SEL_INV_TO_MSLS, /* low-active */
+		.parity_mode = XMC_USIC_CH_PARITY_MODE_NONE
+		};
+
+	const XMC_GPIO_CONFIG_t configAlt = { .mode = SPI_ALT };
+	const XMC_GPIO_CONFIG_t configTri = { .mode = XMC_GPIO_MODE_INPUT_TRISTATE };
+	XMC_GPIO_Init (SPI_MOSI, &configAlt);
+	XMC_GPIO_Init (SPI_SS, &configAlt);
+	XMC_GPIO_Init (SPI_SCLK, &configAlt);
+	XMC_GPIO_Init (SPI_MISO, &configTri);
+
+	/* init spi */
+	XMC_SPI_CH_Init(spi, &config);
+
+	XMC_SPI_CH_SetInputSource(spi, XMC_USIC_CH_INPUT_DX0, SPI_INPUTSRC);
+	XMC_SPI_CH_SetBitOrderMsbFirst (spi);
+	/* the clock must be shifted by half a period, so data on MOSI is set on
+	 * falling edge. The TDA samples its signal on the rising edge */
+	XMC_USIC_CH_ConfigureShiftClockOutput (spi,
+			XMC_USIC_CH_BRG_SHIFT_CLOCK_PASSIVE_LEVEL_0_DELAY_ENABLED,
+			XMC_USIC_CH_BRG_SHIFT_CLOCK_OUTPUT_SCLK);
+#if 0
+	XMC_USIC_CH_DisableInputInversion (XMC_SPI1_CH0, XMC_USIC_CH_INPUT_DX0);
+#endif
+
+	XMC_SPI_CH_Start(spi);
+}
+
+/*	Change baudrate and shift clock delay of a running bus, returns false if
+ *	the baudrate cannot be generated
+ */
+static inline bool halSpiTiming (tda5340HalSpi * const spi,
+		const uint32_t baudrate, const bool delay) {
+	if (XMC_SPI_CH_SetBaudrate (spi, baudrate) != XMC_SPI_CH_STATUS_OK) {
+		return false;
+	}
+	XMC_USIC_CH_ConfigureShiftClockOutput (spi, delay ?
+			XMC_USIC_CH_BRG_SHIFT_CLOCK_PASSIVE_LEVEL_0_DELAY_ENABLED :
+			XMC_USIC_CH_BRG_SHIFT_CLOCK_PASSIVE_LEVEL_0_DELAY_DISABLED,
+			XMC_USIC_CH_BRG_SHIFT_CLOCK_OUTPUT_SCLK);
+	return true;
+}
+
+/*	Write one byte to the SPI bus, blocking.
+ */
+static inline uint8_t halSpiByte (tda5340HalSpi * const spi, const uint8_t write) {
+	const uint32_t recvFlag = XMC_SPI_CH_STATUS_FLAG_RECEIVE_INDICATION |
+				XMC_SPI_CH_STATUS_FLAG_ALTERNATIVE_RECEIVE_INDICATION;
+	XMC_SPI_CH_ClearStatusFlag (spi, recvFlag);
+
+	XMC_SPI_CH_Transmit(spi, write, XMC_SPI_CH_MODE_STANDARD);
+
+	while ((XMC_SPI_CH_GetStatusFlag(spi) & (recvFlag)) == 0U);
+
+	/* the value must be read otherwise the buffer is going to overrun and new
+	 * data is not stored anymore */
+	return XMC_SPI_CH_GetReceivedData (spi);
+}
+
+/*	Full-duplex transfer of len bytes, rx may be NULL. Never fails
+ */
+static inline bool halSpiTransfer (tda5340HalSpi * const spi,
+		const uint8_t * const tx, uint8_t * const rx, const size_t len) {
+	for (size_t i = 0; i < len; i++) {
+		const uint8_t r = halSpiByte (spi, tx != NULL ? tx[i] : 0x00);
+		if (rx != NULL) {
+			rx[i] = r;
+		}
+	}
+	return true;
+}
+
+/*	Shift data lsb first (fifo data) or msb first (everything else)
+ */
+static inline void halSpiBitOrder (tda5340HalSpi * const spi, const bool lsbFirst) {
+	if (lsbFirst) {
+		XMC_SPI_CH_SetBitOrderLsbFirst (spi);
+	} else {
+		XMC_SPI_CH_SetBitOrderMsbFirst (spi);
+	}
+}
+
+static inline void halSsEnable (tda5340HalSpi * const spi) {
+	XMC_SPI_CH_EnableSlaveSelect(spi, XMC_SPI_CH_SLAVE_SELECT_0);
+}
+
+static inline void halSsDisable (tda5340HalSpi * const spi) {
+	XMC_SPI_CH_DisableSlaveSelect (spi);
+}
+
+/*	Initialize PON pin
+ */
+static inline void halPonInit (tda5340HalSpi * const spi) {
+	const XMC_GPIO_CONFIG_t config = {
+			.mode = XMC_GPIO_MODE_OUTPUT_PUSH_PULL,
+			.output_level = XMC_GPIO_OUTPUT_LEVEL_LOW,
+			};
+	XMC_GPIO_Init (TDAPON, &config);
+}
+
+static inline void halPonSet (tda5340HalSpi * const spi, const bool high) {
+	if (high) {
+		XMC_GPIO_SetOutputHigh (TDAPON);
+	} else {
+		XMC_GPIO_SetOutputLow (TDAPON);
+	}
+}
+
+/*	Initialize NINT pin and interrupt handler
+ *
+ *	:param priority: priority for NINT interrupt, encoded with NVIC_EncodePriority()
+ */
+static inline void halNintInit (tda5340HalSpi * const spi, const uint32_t priority) {
+	const XMC_GPIO_CONFIG_t config = {
+			.mode = XMC_GPIO_MODE_INPUT_TRISTATE,
+			};
+	XMC_GPIO_Init (TDANINT, &config);
+
+	static const XMC_ERU_ETL_CONFIG_t etlCfg = {
+		/* XXX: is is _very_ important that you use .input_a OR .input_b here
+		 * and NOT (BY ALL FUCKING MEANS NOT!) .input */
+		ETL_SRCPIN,
+		.source = ETL_SRCAB,
+		.edge_detection = XMC_ERU_ETL_EDGE_DETECTION_FALLING,
+		.status_flag_mode = XMC_ERU_ETL_STATUS_FLAG_MODE_HWCTRL,
+		.enable_output_trigger = true,
+		/* trigger ogu x */
+		.output_trigger_channel = ETL_CHANNEL,
+		};
+	static const XMC_ERU_OGU_CONFIG_t oguCfg = {
+		.service_request = XMC_ERU_OGU_SERVICE_REQUEST_ON_TRIGGER
+		};
+	XMC_ERU_ETL_Init(ETL, &etlCfg);
+	XMC_ERU_OGU_Init(OGU, &oguCfg);
+
+	NVIC_SetPriority(INTERRUPT, priority);
+	NVIC_EnableIRQ(INTERRUPT);
+}
+
+/*	NINT was pulled low. Triggering on falling edge, flag is cleared by
+ *	hardware on positive edge
+ */
+static inline bool halNintFlag (tda5340HalSpi * const spi) {
+	return XMC_ERU_ETL_GetStatusFlag (ETL);
+}
+
+static inline void halNintDisable (tda5340HalSpi * const spi) {
+	NVIC_DisableIRQ(INTERRUPT);
+}
+
+static inline void halNintEnable (tda5340HalSpi * const spi) {
+	NVIC_EnableIRQ(INTERRUPT);
+}
+
+/*	Initialize the scheduling timer, one-shot with 1/32 of the CCU clock
+ */
+static inline void halTimerInit (tda5340HalSpi * const spi, const uint32_t priority) {
+	static const XMC_CCU4_SLICE_COMPARE_CONFIG_t config = {
+		.timer_mode = XMC_CCU4_SLICE_TIMER_COUNT_MODE_EA,
+		.monoshot = XMC_CCU4_SLICE_TIMER_REPEAT_MODE_SINGLE,
+		.prescaler_initval = XMC_CCU4_SLICE_PRESCALER_32,
+		};
+	XMC_CCU4_Init (TIMER_MODULE, XMC_CCU4_SLICE_MCMS_ACTION_TRANSFER_PR_CR);
+	XMC_CCU4_StartPrescaler (TIMER_MODULE);
+	XMC_CCU4_SLICE_CompareInit (TIMER_SLICE, &config);
+	XMC_CCU4_SLICE_EnableEvent (TIMER_SLICE, XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH);
+	XMC_CCU4_SLICE_SetInterruptNode (TIMER_SLICE,
+			XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH, XMC_CCU4_SLICE_SR_ID_0);
+	XMC_CCU4_EnableClock (TIMER_MODULE, 0);
+
+	NVIC_SetPriority (TIMER_INTERRUPT, priority);
+	NVIC_EnableIRQ (TIMER_INTERRUPT);
+}
+
+/*	Fire TDA5340TIMERHANDLER in delay μs. The 16 bit timer covers about
+ *	17 ms (XMC4500) or 65 ms (XMC1100), longer delays fire early.
+ */
+static inline void halTimerArm (tda5340HalSpi * const spi, const uint32_t delay) {
+#if UC_SERIES == XMC11
+	const uint32_t ticksPerMs = (XMC_SCU_CLOCK_GetPeripheralClockFrequency () >> 5)/1000;
+#elif UC_SERIES == XMC45
+	const uint32_t ticksPerMs = (XMC_SCU_CLOCK_GetCcuClockFrequency () >> 5)/1000;
+#endif
+	const uint32_t maxDelay = 0xffffUL*1000/ticksPerMs;
+	const uint32_t ticks = (delay < maxDelay ? delay : maxDelay)*ticksPerMs/1000;
+
+	XMC_CCU4_SLICE_StopTimer (TIMER_SLICE);
+	XMC_CCU4_SLICE_ClearTimer (TIMER_SLICE);
+	XMC_CCU4_SLICE_ClearEvent (TIMER_SLICE, XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH);
+	XMC_CCU4_SLICE_SetTimerPeriodMatch (TIMER_SLICE, ticks > 0 ? ticks : 1);
+	XMC_CCU4_EnableShadowTransfer (TIMER_MODULE, XMC_CCU4_SHADOW_TRANSFER_SLICE_0);
+	XMC_CCU4_SLICE_StartTimer (TIMER_SLICE);
+}
+
+static inline void halTimerAck (tda5340HalSpi * const spi) {
+	XMC_CCU4_SLICE_ClearEvent (TIMER_SLICE, XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH);
+}
+
+/*	Disarm, drops an expiry that is not handled yet
+ */
+static inline void halTimerStop (tda5340HalSpi * const spi) {
+	XMC_CCU4_SLICE_StopTimer (TIMER_SLICE);
+	XMC_CCU4_SLICE_ClearEvent (TIMER_SLICE, XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH);
+	NVIC_ClearPendingIRQ (TIMER_INTERRUPT);
+}
+
+static inline void halTimerDisable (tda5340HalSpi * const spi) {
+	NVIC_DisableIRQ(TIMER_INTERRUPT);
+}
+
+static inline void halTimerEnable (tda5340HalSpi * const spi) {
+	NVIC_EnableIRQ(TIMER_INTERRUPT);
+}
+
+/*	Take lock, returns false if it was taken already
+ */
+static inline bool halLock (volatile uint8_t * const lock) {
+#if UC_SERIES == XMC11
+	/* μc lacks atomic compare & swap */
+	bool ret = false;
+	__disable_irq ();
+	if (*lock == 0) {
+		*lock = 1;
+		ret = true;
+	}
+	__enable_irq ();
+	return ret;
+#elif UC_SERIES == XMC45
+	return __sync_bool_compare_and_swap (lock, 0, 1);
+#endif
+}
+
+/*	Increment and return the old value
+ */
+static inline uint32_t halAtomicIncrement (volatile uint32_t * const v) {
+#if UC_SERIES == XMC11
+	/* μc lacks atomic fetch & add */
+	const uint32_t primask = __get_PRIMASK ();
+	__disable_irq ();
+	const uint32_t old = (*v)++;
+	__set_PRIMASK (primask);
+	return old;
+#elif UC_SERIES == XMC45
+	return __sync_fetch_and_add (v, 1);
+#endif
+}
+
+/*	Start the timebase. With configure the driver owns SysTick and sets a
+ *	1 ms period, TDA5340TIMEHANDLER must call tda5340TimeTick. Otherwise
+ *	SysTick is already running off the CPU clock (application or RTOS tick)
+ *	and its handler calls tda5340TimeTick, at any period of whole μs
+ */
+static inline void halTimeInit (const bool configure) {
+	const uint32_t cpu = XMC_SCU_CLOCK_GetCpuClockFrequency ();
+	if (configure) {
+		SysTick_Config (cpu/1000);
+	}
+	halTimeCyclesPerUs = cpu/1000000;
+	halTimeTickUs = (SysTick->LOAD + 1)/halTimeCyclesPerUs;
+}
+
+static inline void halTimeTick (void) {
+	halTimeTicks++;
+}
+
+/*	μs since halTimeInit, wraps after 2^32 μs
+ */
+static inline uint32_t halTimeNow (void) {
+	const uint32_t reload = SysTick->LOAD + 1;
+	uint32_t ticks, val;
+	bool pending;
+	do {
+		ticks = halTimeTicks;
+		val = SysTick->VAL;
+		pending = SCB->ICSR & SCB_ICSR_PENDSTSET_Msk;
+	} while (ticks != halTimeTicks);
+	/* the tick is not handled yet (interrupts disabled or we are the higher
+	 * priority handler), but the counter was reloaded before reading it */
+	if (pending && val > reload/2) {
+		ticks++;
+	}
+	/* SysTick counts down */
+	return ticks*halTimeTickUs + (reload - 1 - val)/halTimeCyclesPerUs;
+}
+
+/* minimum cycles per iteration of the halDelayus fallback loop (subs, taken
+ * bne), flash wait states only make it slower */
+#if UC_SERIES == XMC11
+#define HAL_DELAY_LOOP_CYCLES 4
+#elif UC_SERIES == XMC45
+#define HAL_DELAY_LOOP_CYCLES 3
+#endif
+
+/*	Busy-wait without the tick interrupt, so it works with interrupts
+ *	disabled, from handlers outranking SysTick and before the timebase is
+ *	started. Counts SysTick cycles if the counter is enabled, a loop with
+ *	known cycle count otherwise (at least delay μs, longer with flash wait
+ *	states or interrupts)
+ */
+static inline void halDelayus (const uint32_t delay) {
+	const uint32_t cyclesPerUs = XMC_SCU_CLOCK_GetCpuClockFrequency ()/1000000;
+	if (!(SysTick->CTRL & SysTick_CTRL_ENABLE_Msk)) {
+		uint32_t loops = delay*cyclesPerUs/HAL_DELAY_LOOP_CYCLES + 1;
+#if UC_SERIES == XMC11
+		__asm__ volatile ("1: subs %0, %0, #1\n\tbne 1b" : "+l" (loops) : : "cc");
+#elif UC_SERIES == XMC45
+		__asm__ volatile ("1: subs %0, %0, #1\n\tbne 1b" : "+r" (loops) : : "cc");
+#endif
+		return;
+	}
+	const uint32_t reload = SysTick->LOAD + 1;
+	uint64_t remaining = (uint64_t) delay*cyclesPerUs;
+	uint32_t last = SysTick->VAL;
+	while (remaining > 0) {
+		const uint32_t val = SysTick->VAL;
+		/* counts down, reloads at zero */
+		const uint32_t elapsed = last >= val ? last - val : last + reload - val;
+		last = val;
+		remaining = elapsed < remaining ? remaining - elapsed : 0;
+	}
+}
@@ -0,0 +1,286 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <string.h>
+
+#include "tda5340_link.h"
+
+enum {
+	LINK_DATA = 1,
+	LINK_ACK,
+	LINK_NACK,
+};
+
+/* type, destination, source, sequence number, acknowledgement (next
+ * expected for ACK/NACK, sender’s window base for data) */
+#define LINK_HEADER 5
+
+static tda5340LinkSlot *slot (tda5340Link * const link, const uint8_t seq) {
+	return &link->slots[seq % TDA_LINK_WINDOW];
+}
+
+static uint8_t outstanding (const tda5340Link * const link) {
+	return link->next - link->base;
+}
+
+/*	Frame a link packet into buf, returns bits
+ */
+static size_t build (const tda5340Link * const link, uint8_t * const buf,
+		const uint8_t type, const uint8_t seq, const uint8_t ack,
+		const uint8_t * const payload, const uint8_t len) {
+	uint8_t packet[LINK_HEADER + TDA_LINK_MTU] = {type, link->peer, link->addr,
+			seq, ack};
+	memcpy (&packet[LINK_HEADER], payload, len);
+	const size_t bits = tda5340FrameBuild (link->frame, packet,
+			LINK_HEADER + len, buf, TDA_LINK_FRAME_SIZE);
+	/* framing options too large for TDA_LINK_FRAME_SIZE */
+	assert (bits > 0);
+	return bits;
+}
+
+static void transmit (tda5340Link * const link, const uint8_t seq) {
+	tda5340LinkSlot * const s = slot (link, seq);
+	const size_t bits = build (link, link->txbuf, LINK_DATA, seq, link->base,
+			s->data, s->len);
+	if (link->send (link, link->txbuf, bits)) {
+		if (s->sent) {
+			s->retransmitted = true;
+			link->stats.retransmissions++;
+		}
+		s->sent = true;
+		s->sentAt = link->now ();
+		link->stats.txFrames++;
+	}
+}
+
+/*	Send ACK or NACK for link->expected, ACKs are usually prepared already
+ */
+static void acknowledge (tda5340Link * const link, const uint8_t type) {
+	if (type == LINK_ACK && link->ackFor == link->expected) {
+		link->send (link, link->ack, link->ackBits);
+	} else {
+		const size_t bits = build (link, link->txbuf, type, 0, link->expected,
+				NULL, 0);
+		link->send (link, link->txbuf, bits);
+	}
+}
+
+/*	Prepare the ACK for the next in order frame, off the turnaround path
+ */
+static void ackPrepare (tda5340Link * const link) {
+	link->ackFor = link->expected + 1;
+	link->ackBits = build (link, link->ack, LINK_ACK, 0, link->ackFor, NULL, 0);
+}
+
+static void rttUpdate (tda5340Link * const link, const uint32_t rtt) {
+	if (link->srtt == 0) {
+		link->srtt = rtt;
+		link->rttvar = rtt/2;
+	} else {
+		const uint32_t delta = link->srtt > rtt ? link->srtt - rtt : rtt - link->srtt;
+		link->rttvar = (3*link->rttvar + delta)/4;
+		link->srtt = (7*link->srtt + rtt)/8;
+	}
+	const uint32_t rto = link->srtt + 4*link->rttvar;
+	link->rto = rto < link->rtoMin ? link->rtoMin :
+			(rto > link->rtoMax ? link->rtoMax : rto);
+}
+
+/*	Cumulative acknowledgement, everything before ack arrived
+ */
+static void ackUpTo (tda5340Link * const link, const uint8_t ack) {
+	const uint8_t n = ack - link->base;
+	if (n == 0 || n > outstanding (link)) {
+		/* stale or bogus */
+		return;
+	}
+	/* Karn: sample only frames sent exactly once */
+	const tda5340LinkSlot * const last = slot (link, ack - 1);
+	if (last->sent && !last->retransmitted) {
+		rttUpdate (link, link->now () - last->sentAt);
+	}
+	for (uint8_t seq = link->base; seq != ack; seq++) {
+		link->stats.ackedFrames++;
+		link->stats.ackedBytes += slot (link, seq)->len;
+	}
+	link->base = ack;
+}
+
+void tda5340LinkInit (tda5340Link * const link) {
+	assert (link != NULL);
+	assert (link->frame != NULL);
+	assert (link->window > 0 && link->window <= TDA_LINK_WINDOW);
+	assert (link->rtoMin > 0 && link->rtoMin <= link->rtoMax);
+	assert (link->send != NULL && link->now != NULL);
+
+	link->base = link->next = link->expected = 0;
+	link->srtt = link->rttvar = 0;
+	link->rto = link->rtoMax;
+	link->nackFor = 0xff;
+	memset (&link->stats, 0, sizeof (link->stats));
+	ackPrepare (link);
+}
+
+/*	Queue len bytes for the peer and send them, false if the window is full
+ */
+bool tda5340LinkSend (tda5340Link * const link, const uint8_t * const data,
+		const uint8_t len) {
+	assert (link != NULL);
+	assert (data != NULL || len == 0);
+	assert (len <= TDA_LINK_MTU);
+
+	if (outstanding (link) >= link->window) {
+		return false;
+	}
+	const uint8_t seq = link->next++;
+	tda5340LinkSlot * const s = slot (link, seq);
+	memcpy (s->data, data, len);
+	s->len = len;
+	s->retries = 0;
+	s->sent = s->retransmitted = false;
+	transmit (link, seq);
+	return true;
+}
+
+/*	Process a received frame in buf (decoded in place). Returns false if it
+ *	was not for this link, so it can be offered to others.
+ */
+bool tda5340LinkReceive (tda5340Link * const link, uint8_t * const buf,
+		const size_t bits) {
+	assert (link != NULL);
+
+	const uint8_t *p;
+	uint8_t len;
+	if (tda5340FrameParse (link->frame, buf, bits, &p, &len) != TDA_FRAME_OK ||
+			len < LINK_HEADER) {
+		link->stats.badFrames++;
+		return false;
+	}
+	const uint8_t type = p[0], dst = p[1], src = p[2], seq = p[3], ack = p[4];
+	if (dst != link->addr || src != link->peer) {
+		return false;
+	}
+
+	switch (type) {
+		case LINK_DATA: {
+			/* the sender gave up on frames before its window base */
+			const uint8_t skip = ack - link->expected;
+			if (skip > 0 && skip < 128) {
+				link->expected = ack;
+			}
+			const uint8_t d = seq - link->expected;
+			if (d == 0) {
+				/* acknowledge first, keeps the turnaround short */
+				link->expected++;
+				acknowledge (link, LINK_ACK);
+				link->stats.rxFrames++;
+				link->stats.rxBytes += len - LINK_HEADER;
+				if (link->deliver != NULL) {
+					link->deliver (link, &p[LINK_HEADER], len - LINK_HEADER);
+				}
+				ackPrepare (link);
+			} else if (d >= 128) {
+				/* old frame, our ACK got lost */
+				link->stats.duplicates++;
+				acknowledge (link, LINK_ACK);
+			} else if (link->nackFor != link->expected) {
+				/* gap, ask for the missing one, but only once */
+				link->nackFor = link->expected;
+				link->stats.nacksSent++;
+				acknowledge (link, LINK_NACK);
+			}
+			break;
+		}
+
+		case LINK_ACK:
+			ackUpTo (link, ack);
+			break;
+
+		case LINK_NACK:
+			ackUpTo (link, ack);
+			link->stats.nacksReceived++;
+			/* go back to ack, unless that happened within the last round
+			 * trip already */
+			if (outstanding (link) > 0 && link->base == ack &&
+					link->now () - slot (link, ack)->sentAt >= link->srtt) {
+				for (uint8_t seq = link->base; seq != link->next; seq++) {
+					transmit (link, seq);
+				}
+			}
+			break;
+
+		default:
+			link->stats.badFrames++;
+			break;
+	}
+	return true;
+}
+
+/*	Retransmit timed out frames. Returns μs until the next timeout, so the
+ *	caller can sleep, UINT32_MAX if nothing is in flight.
+ */
+uint32_t tda5340LinkPoll (tda5340Link * const link) {
+	assert (link != NULL);
+
+	const uint32_t now = link->now ();
+	uint32_t wait = UINT32_MAX;
+	bool backoff = false;
+	for (uint8_t seq = link->base; seq != link->next; seq++) {
+		tda5340LinkSlot * const s = slot (link, seq);
+		if (!s->sent) {
+			/* radio was busy */
+			transmit (link, seq);
+			continue;
+		}
+		const uint32_t elapsed = now - s->sentAt;
+		if (elapsed < link->rto) {
+			if (link->rto - elapsed < wait) {
+				wait = link->rto - elapsed;
+			}
+			continue;
+		}
+
+		link->stats.timeouts++;
+		backoff = true;
+		if (s->retries >= link->retries) {
+			/* give up on everything up to here, the peer skips them too */
+			/* uint8_t, so the bound wraps like the sequence numbers */
+			const uint8_t end = seq + 1;
+			for (uint8_t failed = link->base; failed != end; failed++) {
+				link->stats.failed++;
+				if (link->failed != NULL) {
+					link->failed (link, failed);
+				}
+			}
+			link->base = end;
+		} else {
+			s->retries++;
+			transmit (link, seq);
+		}
+	}
+	if (backoff) {
+		link->rto = link->rto > link->rtoMax/2 ? link->rtoMax : 2*link->rto;
+	}
+	return outstanding (link) > 0 ? (wait < link->rto ? wait : link->rto) :
+			UINT32_MAX;
+}
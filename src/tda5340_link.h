@@ -0,0 +1,111 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tda5340_frame.h"
+
+/* Reliable link to a single peer: sequence numbers, cumulative ACKs, NACKs
+ * on gaps, Go-Back-N retransmission from a sliding window and adaptive
+ * timeouts. Independent of the hardware, the radio is reached through the
+ * send callback only, so two links can be wired back to back on a host.
+ * tda5340LinkAttach binds a link to a TDA. */
+
+/* maximum window depth (power of two) and payload per frame */
+#define TDA_LINK_WINDOW 8
+#define TDA_LINK_MTU 16
+/* frame buffer, fits the TDA’s transmit fifo */
+#define TDA_LINK_FRAME_SIZE 32
+
+typedef struct {
+	/* data frames sent, including retransmissions */
+	uint32_t txFrames, retransmissions, timeouts, nacksReceived;
+	/* acknowledged frames and payload bytes (goodput), frames given up */
+	uint32_t ackedFrames, ackedBytes, failed;
+	/* delivered frames and payload bytes, duplicates, frames that could not
+	 * be parsed */
+	uint32_t rxFrames, rxBytes, duplicates, badFrames, nacksSent;
+} tda5340LinkStats;
+
+typedef struct {
+	uint8_t data[TDA_LINK_MTU];
+	uint8_t len, retries;
+	/* transmitted at least once, retransmitted (no RTT sample then) */
+	bool sent, retransmitted;
+	uint32_t sentAt;
+} tda5340LinkSlot;
+
+struct tda5340Link;
+/* transmit bits of data right away (or queue it), false if impossible */
+typedef bool (*tda5340LinkTransmit) (struct tda5340Link * const,
+		const uint8_t * const, const size_t);
+/* in order payload from the peer */
+typedef void (*tda5340LinkDeliver) (struct tda5340Link * const,
+		const uint8_t * const, const uint8_t);
+/* frame with sequence number could not be delivered */
+typedef void (*tda5340LinkFailed) (struct tda5340Link * const, const uint8_t);
+
+typedef struct tda5340Link {
+	/* framing options, CRC is strongly recommended */
+	const tda5340Frame *frame;
+	/* own and peer address */
+	uint8_t addr, peer;
+	/* frames in flight (1…TDA_LINK_WINDOW), retransmissions per frame */
+	uint8_t window, retries;
+	/* retransmission timeout bounds in μs, starts at rtoMax */
+	uint32_t rtoMin, rtoMax;
+
+	tda5340LinkTransmit send;
+	/* μs clock */
+	uint32_t (*now) (void);
+	tda5340LinkDeliver deliver;
+	tda5340LinkFailed failed;
+	/* callback data and radio binding (tda5340LinkAttach) */
+	void *data, *radio;
+
+	tda5340LinkStats stats;
+
+	/* private data, do not touch */
+	tda5340LinkSlot slots[TDA_LINK_WINDOW];
+	/* oldest unacknowledged and next sequence number */
+	uint8_t base, next;
+	/* next sequence number expected from the peer, last NACK sent */
+	uint8_t expected, nackFor;
+	/* smoothed RTT, its variation and the current timeout in μs */
+	uint32_t srtt, rttvar, rto;
+	/* ACK for ackFor, built ahead of time */
+	uint8_t ack[TDA_LINK_FRAME_SIZE];
+	size_t ackBits;
+	uint8_t ackFor;
+	uint8_t txbuf[TDA_LINK_FRAME_SIZE];
+} tda5340Link;
+
+void tda5340LinkInit (tda5340Link * const link);
+bool tda5340LinkSend (tda5340Link * const link, const uint8_t * const data,
+		const uint8_t len);
+bool tda5340LinkReceive (tda5340Link * const link, uint8_t * const buf,
+		const size_t bits);
+uint32_t tda5340LinkPoll (tda5340Link * const link);
@@ -0,0 +1,49 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+/* Optional RTOS integration. Every port provides the tda5340OsMutex and
+ * tda5340OsEvent types and the static inline os* hooks below, used for bus
+ * ownership and the blocking calls, see tda5340OsAttach:
+ *
+ * osMutexInit, osMutexLock, osMutexUnlock: recursive mutual exclusion
+ *	between threads
+ * osEventInit, osEventSet, osEventWait: event flags, set from any context,
+ *	waited for by threads with a μs timeout (TDA_OS_FOREVER)
+ * osInThread: whether the caller may block, false in interrupt context
+ *
+ * Define TDA_OS_PORT to the port header for other systems. Linux defaults to
+ * pthreads, everything else to bare metal. */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TDA_OS_FOREVER UINT32_MAX
+
+#if defined(TDA_OS_PORT)
+#include TDA_OS_PORT
+#elif defined(__linux__)
+#include "tda5340_os_pthread.h"
+#else
+#include "tda5340_os_none.h"
+#endif
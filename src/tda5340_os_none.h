@@ -0,0 +1,86 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+/* Bare metal, do not include directly, see tda5340_os.h
+ *
+ * There is a single thread only, the NINT interrupt is masked while it owns
+ * the bus, so mutexes are no-ops. Waiting sleeps until the next interrupt. */
+
+#include <assert.h>
+
+#include "tda5340_hal.h"
+#include "tda5340_time.h"
+
+typedef uint8_t tda5340OsMutex;
+typedef volatile uint32_t tda5340OsEvent;
+
+static inline void osMutexInit (tda5340OsMutex * const m) {
+}
+
+static inline void osMutexLock (tda5340OsMutex * const m) {
+}
+
+static inline void osMutexUnlock (tda5340OsMutex * const m) {
+}
+
+static inline bool osInThread (void) {
+	/* no thread ever waits for the mutex */
+	return false;
+}
+
+static inline void osEventInit (tda5340OsEvent * const e) {
+	*e = 0;
+}
+
+static inline void osEventSet (tda5340OsEvent * const e, const uint32_t flags) {
+	const uint32_t primask = __get_PRIMASK ();
+	__disable_irq ();
+	*e |= flags;
+	__set_PRIMASK (primask);
+}
+
+/*	Wait for any of flags, clears and returns the ones that were set, 0 on
+ *	timeout
+ */
+static inline uint32_t osEventWait (tda5340OsEvent * const e, const uint32_t flags,
+		const uint32_t timeout) {
+	/* finite timeouts need the timebase, polling (0) does not */
+	assert (timeout == 0 || timeout == TDA_OS_FOREVER || tda5340TimeRunning ());
+	const uint32_t start = halTimeNow ();
+	while (true) {
+		const uint32_t primask = __get_PRIMASK ();
+		__disable_irq ();
+		const uint32_t got = *e & flags;
+		*e &= ~got;
+		__set_PRIMASK (primask);
+		if (got != 0) {
+			return got;
+		}
+		if (timeout != TDA_OS_FOREVER && halTimeNow () - start >= timeout) {
+			return 0;
+		}
+		/* the timebase tick wakes us up periodically */
+		__WFI ();
+	}
+}
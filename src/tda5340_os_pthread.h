@@ -0,0 +1,110 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+/* POSIX threads, do not include directly, see tda5340_os.h
+ *
+ * Run the tda5340HalLinuxWait loop calling tda5340IrqHandle in one thread,
+ * tda5340SendWait and tda5340ReceiveWait may be called from any other. There
+ * is no interrupt to mask, so the handler and every bus transaction, mode
+ * change and transmit queue update serialize on the recursive driver mutex
+ * instead. */
+
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+typedef pthread_mutex_t tda5340OsMutex;
+
+typedef struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	uint32_t flags;
+} tda5340OsEvent;
+
+static inline void osMutexInit (tda5340OsMutex * const m) {
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init (&attr);
+	pthread_mutexattr_settype (&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init (m, &attr);
+	pthread_mutexattr_destroy (&attr);
+}
+
+static inline void osMutexLock (tda5340OsMutex * const m) {
+	pthread_mutex_lock (m);
+}
+
+static inline void osMutexUnlock (tda5340OsMutex * const m) {
+	pthread_mutex_unlock (m);
+}
+
+static inline bool osInThread (void) {
+	/* there is no interrupt context */
+	return true;
+}
+
+static inline void osEventInit (tda5340OsEvent * const e) {
+	pthread_mutex_init (&e->lock, NULL);
+	pthread_condattr_t attr;
+	pthread_condattr_init (&attr);
+	pthread_condattr_setclock (&attr, CLOCK_MONOTONIC);
+	pthread_cond_init (&e->cond, &attr);
+	pthread_condattr_destroy (&attr);
+	e->flags = 0;
+}
+
+static inline void osEventSet (tda5340OsEvent * const e, const uint32_t flags) {
+	pthread_mutex_lock (&e->lock);
+	e->flags |= flags;
+	pthread_cond_broadcast (&e->cond);
+	pthread_mutex_unlock (&e->lock);
+}
+
+/*	Wait for any of flags, clears and returns the ones that were set, 0 on
+ *	timeout
+ */
+static inline uint32_t osEventWait (tda5340OsEvent * const e, const uint32_t flags,
+		const uint32_t timeout) {
+	struct timespec deadline;
+	clock_gettime (CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += timeout / 1000000;
+	deadline.tv_nsec += (timeout % 1000000) * 1000;
+	if (deadline.tv_nsec >= 1000000000) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock (&e->lock);
+	while ((e->flags & flags) == 0) {
+		if (timeout == TDA_OS_FOREVER) {
+			pthread_cond_wait (&e->cond, &e->lock);
+		} else if (pthread_cond_timedwait (&e->cond, &e->lock,
+				&deadline) == ETIMEDOUT) {
+			break;
+		}
+	}
+	const uint32_t got = e->flags & flags;
+	e->flags &= ~got;
+	pthread_mutex_unlock (&e->lock);
+	return got;
+}
@@ -0,0 +1,248 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* generated by tools/tda5340regmeta.py, do not edit */
+
+#include "tda5340_reg.h"
+
+/* common attributes */
+#define CFG (TDA_REG_VALID | TDA_REG_READ | TDA_REG_WRITE | TDA_REG_CONFIG)
+#define MCFG (CFG | TDA_REG_MIRROR)
+#define STATUS (TDA_REG_VALID | TDA_REG_MIRROR | TDA_REG_READ | TDA_REG_VOLATILE)
+#define CMD (TDA_REG_VALID | TDA_REG_MIRROR | TDA_REG_READ | TDA_REG_WRITE | \
+		TDA_REG_VOLATILE)
+#define CONST (TDA_REG_VALID | TDA_REG_MIRROR | TDA_REG_READ)
+
+/* Register attributes, indexed by the address’ low byte. Configuration
+ * registers 0x00…0x84 exist once per page (config A…D), everything from
+ * 0xa0 upwards is mirrored on all pages. Gaps are invalid. */
+const uint8_t tda5340RegMeta[256] = {
+	[TDA_A_MID0] = CFG,
+	[TDA_A_MID1] = CFG,
+	[TDA_A_MID2] = CFG,
+	[TDA_A_MID3] = CFG,
+	[TDA_A_MID4] = CFG,
+	[TDA_A_MID5] = CFG,
+	[TDA_A_MID6] = CFG,
+	[TDA_A_MID7] = CFG,
+	[TDA_A_MID8] = CFG,
+	[TDA_A_MID9] = CFG,
+	[TDA_A_MID10] = CFG,
+	[TDA_A_MID11] = CFG,
+	[TDA_A_MID12] = CFG,
+	[TDA_A_MID13] = CFG,
+	[TDA_A_MID14] = CFG,
+	[TDA_A_MID15] = CFG,
+	[TDA_A_MID16] = CFG,
+	[TDA_A_MID17] = CFG,
+	[TDA_A_MID18] = CFG,
+	[TDA_A_MID19] = CFG,
+	[TDA_A_MIDC0] = CFG,
+	[TDA_A_MIDC1] = CFG,
+	[TDA_A_IF1] = CFG,
+	[TDA_A_WUC] = CFG,
+	[TDA_A_WUPAT0] = CFG,
+	[TDA_A_WUPAT1] = CFG,
+	[TDA_A_WUBCNT] = CFG,
+	[TDA_A_WURSSITH1] = CFG,
+	[TDA_A_WURSSIBL1] = CFG,
+	[TDA_A_WURSSIBH1] = CFG,
+	[TDA_A_WURSSITH2] = CFG,
+	[TDA_A_WURSSIBL2] = CFG,
+	[TDA_A_WURSSIBH2] = CFG,
+	[TDA_A_WURSSITH3] = CFG,
+	[TDA_A_WURSSIBL3] = CFG,
+	[TDA_A_WURSSIBH3] = CFG,
+	[TDA_A_WURSSITH4] = CFG,
+	[TDA_A_WURSSIBL4] = CFG,
+	[TDA_A_WURSSIBH4] = CFG,
+	[TDA_A_SRTHR] = CFG,
+	[TDA_A_SIGDETSAT] = CFG,
+	[TDA_A_WULOT] = CFG,
+	[TDA_A_SYSRCTO] = CFG,
+	[TDA_A_TOTIM0] = CFG,
+	[TDA_A_TOTIM1] = CFG,
+	[TDA_A_TOTIM_SYNC] = CFG,
+	[TDA_A_TOTIM_TSI] = CFG,
+	[TDA_A_TOTIM_EOM] = CFG,
+	[TDA_A_AFCLIMIT] = CFG,
+	[TDA_A_AFCAGCADRD] = CFG,
+	[TDA_A_AFCSFCFG] = CFG,
+	[TDA_A_AFCKCFG0] = CFG,
+	[TDA_A_AFCKCFG1] = CFG,
+	[TDA_A_PMFUDSF] = CFG,
+	[TDA_A_AGCSFCFG] = CFG,
+	[TDA_A_AGCCFG0] = CFG,
+	[TDA_A_AGCCFG1] = CFG,
+	[TDA_A_AGCTHR] = CFG,
+	[TDA_A_DIGRXC] = CFG,
+	[TDA_A_PKBITPOS] = CFG,
+	[TDA_A_PDFMFC] = CFG,
+	[TDA_A_PDECF] = CFG,
+	[TDA_A_PDECSCFSK] = CFG,
+	[TDA_A_PDECSCASK] = CFG,
+	[TDA_A_SRC] = CFG,
+	[TDA_A_EXTSLC0] = CFG,
+	[TDA_A_EXTSLC1] = CFG,
+	[TDA_A_EXTSLC2] = CFG,
+	[TDA_A_EXTSLTHR0] = CFG,
+	[TDA_A_EXTSLTHR1] = CFG,
+	[TDA_A_SIGDET0] = CFG,
+	[TDA_A_SIGDET1] = CFG,
+	[TDA_A_SIGDETLO] = CFG,
+	[TDA_A_SIGDETSEL] = CFG,
+	[TDA_A_SIGDETCFG] = CFG,
+	[TDA_A_NDTHRES] = CFG,
+	[TDA_A_NDCONFIG] = CFG,
+	[TDA_A_CDRP] = CFG,
+	[TDA_A_CDRI] = CFG,
+	[TDA_A_CDRCFG0] = CFG,
+	[TDA_A_CDRCFG1] = CFG,
+	[TDA_A_TVWIN] = CFG,
+	[TDA_A_SLCCFG] = CFG,
+	[TDA_A_TSIMODE] = CFG,
+	[TDA_A_TSILENA] = CFG,
+	[TDA_A_TSILENB] = CFG,
+	[TDA_A_TSIGAP] = CFG,
+	[TDA_A_TSIPTA0] = CFG,
+	[TDA_A_TSIPTA1] = CFG,
+	[TDA_A_TSIPTB0] = CFG,
+	[TDA_A_TSIPTB1] = CFG,
+	[TDA_A_EOMC] = CFG,
+	[TDA_A_EOMDLEN] = CFG,
+	[TDA_A_EOMDLENP] = CFG,
+	[TDA_A_CHCFG] = CFG,
+	[TDA_A_TXRF] = CFG,
+	[TDA_A_TXCFG] = CFG,
+	[TDA_A_TXCHOFFS0] = CFG,
+	[TDA_A_TXCHOFFS1] = CFG,
+	[TDA_A_TXBDRDIV0] = CFG,
+	[TDA_A_TXBDRDIV1] = CFG,
+	[TDA_A_TXDSHCFG0] = CFG,
+	[TDA_A_TXDSHCFG1] = CFG,
+	[TDA_A_TXDSHCFG2] = CFG,
+	[TDA_A_TXPOWER0] = CFG,
+	[TDA_A_TXPOWER1] = CFG,
+	[TDA_A_TXFDEV] = CFG,
+	[TDA_A_PLLINTC1] = CFG,
+	[TDA_A_PLLFRAC0C1] = CFG,
+	[TDA_A_PLLFRAC1C1] = CFG,
+	[TDA_A_PLLFRAC2C1] = CFG,
+	[TDA_A_PLLINTC2] = CFG,
+	[TDA_A_PLLFRAC0C2] = CFG,
+	[TDA_A_PLLFRAC1C2] = CFG,
+	[TDA_A_PLLFRAC2C2] = CFG,
+	[TDA_A_PLLINTC3] = CFG,
+	[TDA_A_PLLFRAC0C3] = CFG,
+	[TDA_A_PLLFRAC1C3] = CFG,
+	[TDA_A_PLLFRAC2C3] = CFG,
+	[TDA_A_PLLINTC4] = CFG,
+	[TDA_A_PLLFRAC0C4] = CFG,
+	[TDA_A_PLLFRAC1C4] = CFG,
+	[TDA_A_PLLFRAC2C4] = CFG,
+	[TDA_A_RXPLLBW] = CFG,
+	[TDA_A_TXPLLBW] = CFG,
+	[TDA_A_PLLTST] = CFG,
+	[TDA_A_ANTSW] = CFG,
+	[TDA_A_ADRSFCFG] = CFG,
+	[TDA_A_ADRTCFG0] = CFG,
+	[TDA_A_ADRTCFG1] = CFG,
+	[TDA_A_ADRTCFG2] = CFG,
+	[TDA_A_ADRTHR0] = CFG,
+	[TDA_A_ADRTHR1] = CFG,
+	[TDA_SFRPAGE] = TDA_REG_VALID | TDA_REG_MIRROR | TDA_REG_READ | TDA_REG_WRITE,
+	[TDA_PPCFG0] = MCFG,
+	[TDA_PPCFG1] = MCFG,
+	[TDA_PPCFG2] = MCFG,
+	[TDA_PPCFG3] = MCFG,
+	[TDA_RXRUNCFG0] = MCFG,
+	[TDA_RXRUNCFG1] = MCFG,
+	[TDA_CLKOUT0] = MCFG,
+	[TDA_CLKOUT1] = MCFG,
+	[TDA_CLKOUT2] = MCFG,
+	[TDA_ANTSW] = MCFG,
+	[TDA_RFC] = MCFG,
+	[TDA_XTALCAL0] = MCFG,
+	[TDA_XTALCAL1] = MCFG,
+	[TDA_RSSICFG] = MCFG,
+	[TDA_ADCINSEL] = MCFG,
+	[TDA_RSSIOFFS] = MCFG,
+	[TDA_RSSISLOPE] = MCFG,
+	[TDA_DELOGSFT] = MCFG,
+	[TDA_CDRDRTHRP] = MCFG,
+	[TDA_CDRDRTHRN] = MCFG,
+	[TDA_IM0] = MCFG,
+	[TDA_IM1] = MCFG,
+	[TDA_IM2] = MCFG,
+	[TDA_SPMIP] = MCFG,
+	[TDA_SPMC] = MCFG,
+	[TDA_SPMRT] = MCFG,
+	[TDA_SPMOFFT0] = MCFG,
+	[TDA_SPMOFFT1] = MCFG,
+	[TDA_SPMONTA0] = MCFG,
+	[TDA_SPMONTA1] = MCFG,
+	[TDA_SPMONTB0] = MCFG,
+	[TDA_SPMONTB1] = MCFG,
+	[TDA_SPMONTC0] = MCFG,
+	[TDA_SPMONTC1] = MCFG,
+	[TDA_SPMONTD0] = MCFG,
+	[TDA_SPMONTD1] = MCFG,
+	[TDA_EXTPCMD] = TDA_REG_VALID | TDA_REG_MIRROR | TDA_REG_WRITE | TDA_REG_VOLATILE,
+	[TDA_TXC] = CMD,
+	[TDA_RXC] = CMD,
+	[TDA_CMC] = TDA_REG_VALID | TDA_REG_MIRROR | TDA_REG_WRITE,
+	[TDA_TXCHNL] = MCFG,
+	[TDA_PLLCFG] = MCFG,
+	[TDA_VACERRTH] = MCFG,
+	[TDA_PRBS] = MCFG,
+	[TDA_TXFIFOAEL] = MCFG,
+	[TDA_TXFIFOAFL] = MCFG,
+	[TDA_RXFIFOAFL] = MCFG,
+	[TDA_PLLSTAT] = STATUS,
+	[TDA_IS2] = STATUS | TDA_REG_CLEARONREAD,
+	[TDA_IS0] = STATUS | TDA_REG_CLEARONREAD,
+	[TDA_IS1] = STATUS | TDA_REG_CLEARONREAD,
+	[TDA_RFPLLACC] = STATUS,
+	[TDA_RSSIPWU] = STATUS,
+	[TDA_RSSIPRX] = STATUS,
+	[TDA_RSSIPPL] = STATUS,
+	[TDA_PLDLEN] = STATUS,
+	[TDA_ADCRESH] = STATUS,
+	[TDA_ADCRESL] = STATUS,
+	[TDA_AFCOFFSET] = STATUS,
+	[TDA_AGCADRR] = STATUS,
+	[TDA_SPIAT] = STATUS,
+	[TDA_SPIDT] = STATUS,
+	[TDA_SPICHKSUM] = STATUS,
+	[TDA_SN0] = CONST,
+	[TDA_SN1] = CONST,
+	[TDA_SN2] = CONST,
+	[TDA_SN3] = CONST,
+	[TDA_CHIPID] = CONST,
+	[TDA_RSSIRX] = STATUS,
+	[TDA_RSSIPMF] = STATUS,
+	[TDA_SPWR] = STATUS,
+	[TDA_NPWR] = STATUS,
+	};
+
+_Static_assert (TDA_REG_CONFIG_PAGED == 0x85, "paged config");
+_Static_assert (TDA_REG_CONFIG_MIRRORED == 43, "mirrored config");
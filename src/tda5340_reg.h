@@ -22,6 +22,8 @@ THE SOFTWARE.
 
 #pragma once
 
+#include <stdint.h>
+
 /* TDA5340 register address definitions */
 #define TDA_A_MID0	0x000
 #define TDA_A_MID1	0x001
@@ -629,3 +631,31 @@ THE SOFTWARE.
 #define TDA_D_ADRTHR0	0x383
 #define TDA_D_ADRTHR1	0x384
 
+/* register attributes, see tda5340RegMeta */
+enum {
+	/* register exists */
+	TDA_REG_VALID = 1 << 0,
+	/* mirrored on all pages, no SFRPAGE change required */
+	TDA_REG_MIRROR = 1 << 1,
+	TDA_REG_READ = 1 << 2,
+	TDA_REG_WRITE = 1 << 3,
+	/* reading clears the register */
+	TDA_REG_CLEARONREAD = 1 << 4,
+	/* value may change without being written (status, self-clearing bits),
+	 * never cache */
+	TDA_REG_VOLATILE = 1 << 5,
+	/* part of the chip configuration, stable until written */
+	TDA_REG_CONFIG = 1 << 6,
+};
+
+/* TDA_REG_CONFIG registers per page (0x00…0x84) and mirrored ones, checked
+ * against tda5340RegMeta at compile time */
+#define TDA_REG_CONFIG_PAGED 0x85
+#define TDA_REG_CONFIG_MIRRORED 43
+
+extern const uint8_t tda5340RegMeta[256];
+
+/* attributes of register address */
+static inline uint8_t tda5340RegFlags (const uint16_t reg) {
+	return tda5340RegMeta[reg & 0xff];
+}
@@ -0,0 +1,66 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "tda5340_hal.h"
+#include "tda5340_time.h"
+
+static bool running = HAL_TIME_RUNNING;
+
+static void timeStart (const bool configure) {
+	if (!running) {
+		halTimeInit (configure);
+		running = true;
+	}
+}
+
+/*	Start the timebase and configure its timer, subsequent calls are ignored
+ */
+void tda5340TimeInit (void) {
+	timeStart (true);
+}
+
+/*	Start the timebase on an already running timer owned by the application
+ */
+void tda5340TimeAttach (void) {
+	timeStart (false);
+}
+
+bool tda5340TimeRunning (void) {
+	return running;
+}
+
+/*	Timer tick, call from TDA5340TIMEHANDLER or the application's tick hook
+ */
+void tda5340TimeTick (void) {
+	halTimeTick ();
+}
+
+uint32_t tda5340TimeNow (void) {
+	return halTimeNow ();
+}
+
+/*	Blocking delay, prefer tda5340TimeReached for anything longer than a few
+ *	μs. Does not depend on the tick interrupt
+ */
+void tda5340TimeDelay (const uint32_t us) {
+	halDelayus (us);
+}
@@ -0,0 +1,54 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Monotonic μs timebase, shared by all TDA handles. Timestamps wrap after
+ * 2^32 μs (about 71 minutes), always compare differences. On XMC the
+ * timebase runs off SysTick and is opt-in: either let the driver configure
+ * SysTick with tda5340TimeInit and define its handler
+ *
+ *	void TDA5340TIMEHANDLER (void) {
+ *		tda5340TimeTick ();
+ *	}
+ *
+ * or, if the application or RTOS owns SysTick, call tda5340TimeAttach once it
+ * runs and tda5340TimeTick from the existing tick hook. Without a timebase
+ * tda5340TimeDelay still works, but there are no timestamps and finite
+ * timeouts.
+ */
+
+void tda5340TimeInit (void);
+void tda5340TimeAttach (void);
+bool tda5340TimeRunning (void);
+void tda5340TimeTick (void);
+uint32_t tda5340TimeNow (void);
+void tda5340TimeDelay (const uint32_t us);
+
+/*	Non-blocking delay: deadline = tda5340TimeNow () + us, then poll
+ */
+static inline bool tda5340TimeReached (const uint32_t deadline) {
+	return (int32_t) (tda5340TimeNow () - deadline) >= 0;
+}
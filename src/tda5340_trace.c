@@ -0,0 +1,74 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <stddef.h>
+
+#include "tda5340_hal.h"
+
+#include "tda5340_trace.h"
+
+_Static_assert ((TDA_TRACE_LEN & (TDA_TRACE_LEN-1)) == 0,
+		"TDA_TRACE_LEN must be a power of two");
+
+void tda5340TraceInit (tda5340Trace * const t) {
+	assert (t != NULL);
+
+	t->head = 0;
+	t->tail = 0;
+	t->lost = 0;
+}
+
+/*	Record event. Slots are reserved atomically, so isr and thread can both
+ *	record; the oldest events are overwritten if the reader falls behind.
+ */
+void tda5340TraceRecord (tda5340Trace * const t, const uint32_t time,
+		const uint8_t type, const uint8_t a, const uint16_t b) {
+	const uint32_t slot = halAtomicIncrement (&t->head);
+
+	tda5340TraceEvent * const e = &t->ev[slot & (TDA_TRACE_LEN-1)];
+	e->time = time;
+	e->type = type;
+	e->a = a;
+	e->b = b;
+}
+
+/*	Read oldest event, returns false if there is none. Reader must not be
+ *	interrupted by a writer, i.e. dump traces from the main loop after
+ *	stopping the radio.
+ */
+bool tda5340TraceRead (tda5340Trace * const t, tda5340TraceEvent * const ev) {
+	assert (t != NULL);
+	assert (ev != NULL);
+
+	const uint32_t head = t->head;
+	if (head == t->tail) {
+		return false;
+	}
+	if (head - t->tail > TDA_TRACE_LEN) {
+		t->lost += head - t->tail - TDA_TRACE_LEN;
+		t->tail = head - TDA_TRACE_LEN;
+	}
+	*ev = t->ev[t->tail & (TDA_TRACE_LEN-1)];
+	++t->tail;
+	return true;
+}
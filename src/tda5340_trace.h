@@ -0,0 +1,78 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Binary event trace. Events are fixed-size and recorded into a ring buffer
+ * from thread and interrupt context without formatting, so tracing barely
+ * changes timing. Enable with -DTDA_TRACE and set tda5340Ctx.trace, decode
+ * the dump with tools/tda5340trace.py */
+
+/* ring buffer size in events, must be a power of two */
+#ifndef TDA_TRACE_LEN
+#define TDA_TRACE_LEN 128
+#endif
+
+typedef enum {
+	/* a: spi command, b: (first) address or fifo bits */
+	TDA_TRACE_SPI_BEGIN = 1,
+	TDA_TRACE_SPI_END,
+	/* a: mode */
+	TDA_TRACE_IRQ_ENTER,
+	/* a: mode, b: IS0 << 8 | IS2 */
+	TDA_TRACE_IRQ_EXIT,
+	/* a: mode, b: config */
+	TDA_TRACE_MODE,
+	/* a: retries left, b: address */
+	TDA_TRACE_RETRY,
+	/* rx fifo overflow */
+	TDA_TRACE_OVERFLOW,
+	/* reset check failed, a: IS2, b: IS0 << 8 | IS1 */
+	TDA_TRACE_RESET_FAIL,
+	/* all status registers 0xff */
+	TDA_TRACE_PHISHY,
+} tda5340TraceType;
+
+typedef struct {
+	/* μs, see tda5340Ctx.clock */
+	uint32_t time;
+	uint8_t type;
+	uint8_t a;
+	uint16_t b;
+} tda5340TraceEvent;
+
+typedef struct {
+	tda5340TraceEvent ev[TDA_TRACE_LEN];
+	/* free running write and read positions */
+	volatile uint32_t head;
+	uint32_t tail;
+	/* events overwritten before they were read */
+	uint32_t lost;
+} tda5340Trace;
+
+void tda5340TraceInit (tda5340Trace * const t);
+void tda5340TraceRecord (tda5340Trace * const t, const uint32_t time,
+		const uint8_t type, const uint8_t a, const uint16_t b);
+bool tda5340TraceRead (tda5340Trace * const t, tda5340TraceEvent * const ev);
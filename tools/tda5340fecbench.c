@@ -0,0 +1,134 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* Host benchmark of the FEC and framing layer. Checks that every burst of
+ * up to eight bits inside an interleaver group is corrected and that frames
+ * with a flipped bit survive, then measures encode plus decode throughput
+ * over 256 byte blocks. Exits with 1 if a check fails.
+ *
+ * Build and run from the top level directory:
+ *
+ *	cc -O2 -Isrc -o fecbench tools/tda5340fecbench.c src/tda5340_frame.c \
+ *		src/tda5340_frame_tab.c src/tda5340_fec.c
+ *	./fecbench [iterations] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tda5340_frame.h"
+
+#define BLOCK 256
+
+/*	Flip every burst of eight bits within the first groups of an encoded
+ *	block, all must be corrected
+ */
+static bool checkBursts (void) {
+	uint8_t src[32], enc[2*sizeof (src)], dec[sizeof (src)];
+	for (size_t i = 0; i < sizeof (src); i++) {
+		src[i] = rand ();
+	}
+	tda5340FecEncode (enc, src, sizeof (src));
+
+	bool ok = true;
+	for (unsigned int start = 0; start < 8*sizeof (enc) - 8; start++) {
+		uint8_t damaged[sizeof (enc)];
+		memcpy (damaged, enc, sizeof (enc));
+		for (unsigned int b = start; b < start + 8; b++) {
+			damaged[b/8] ^= 1 << (b%8);
+		}
+		if (!tda5340FecDecode (dec, damaged, sizeof (src), NULL) ||
+				memcmp (dec, src, sizeof (src)) != 0) {
+			printf ("burst at bit %u not corrected\n", start);
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+/*	Build and parse frames of every length with one flipped body bit, for
+ *	all CRC, whitening and Manchester combinations with FEC enabled
+ */
+static bool checkFrames (void) {
+	static const uint8_t header[] = {0xaa, 0xd3};
+	bool ok = true;
+
+	for (unsigned int mode = 0; mode < 12; mode++) {
+		tda5340FecStats stats = {0, 0};
+		const tda5340Frame f = {
+				.header = header,
+				.headerLen = sizeof (header),
+				.crc = mode % 3,
+				.whiten = (mode / 3) & 1,
+				.fec = true,
+				.manchester = (mode / 6) & 1,
+				.fecStats = &stats,
+				};
+		for (uint8_t len = 0; len < 40; len++) {
+			uint8_t buf[400], payload[40];
+			for (uint8_t i = 0; i < len; i++) {
+				payload[i] = rand ();
+			}
+			const size_t bits = tda5340FrameBuild (&f, payload, len, buf,
+					sizeof (buf));
+			buf[sizeof (header) + 3] ^= 0x08;
+			const uint8_t *got;
+			uint8_t gotLen;
+			const tda5340FrameStatus status = tda5340FrameParse (&f,
+					buf + sizeof (header), bits - 8*sizeof (header), &got,
+					&gotLen);
+			if (status != TDA_FRAME_OK || gotLen != len ||
+					memcmp (got, payload, len) != 0) {
+				printf ("frame mode %u length %u failed: %d\n", mode, len,
+						status);
+				ok = false;
+			}
+		}
+	}
+	return ok;
+}
+
+int main (int argc, char **argv) {
+	const unsigned long iterations = argc > 1 ? strtoul (argv[1], NULL, 10) :
+			200000;
+
+	srand (1);
+	if (!checkBursts () || !checkFrames ()) {
+		return 1;
+	}
+
+	static uint8_t block[BLOCK], coded[2*BLOCK];
+	for (size_t i = 0; i < sizeof (block); i++) {
+		block[i] = rand ();
+	}
+	const clock_t start = clock ();
+	for (unsigned long i = 0; i < iterations; i++) {
+		tda5340FecEncode (coded, block, sizeof (block));
+		tda5340FecDecode (block, coded, sizeof (block), NULL);
+	}
+	const double seconds = (double) (clock () - start) / CLOCKS_PER_SEC;
+	printf ("encode+decode: %.1f MB/s (%lu blocks of %d bytes in %.2f s)\n",
+			iterations * BLOCK / seconds / 1e6, iterations, BLOCK, seconds);
+
+	return 0;
+}
@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+"""
+Generate the CRC slice-by-4, PN9 and Hamming tables for the framing layer.
+
+Usage: tda5340frametab.py > src/tda5340_frame_tab.c
+"""
+
+import os, sys
+
+def crcTable (poly, width):
+	t0 = []
+	for i in range (256):
+		c = i
+		for _ in range (8):
+			c = (c >> 1) ^ poly if c & 1 else c >> 1
+		t0.append (c)
+	tables = [t0]
+	for k in range (1, 4):
+		prev = tables[-1]
+		tables.append ([(prev[i] >> 8) ^ t0[prev[i] & 0xff] for i in range (256)])
+	return tables
+
+def pn9 (bits):
+	""" x^9+x^5+1, seed 0x1ff, lsb first """
+	state = 0x1ff
+	out = []
+	for _ in range (bits):
+		out.append (state & 1)
+		bit = (state ^ (state >> 5)) & 1
+		state = (state >> 1) | (bit << 8)
+	b = []
+	for i in range (0, bits, 8):
+		b.append (sum (out[i+j] << j for j in range (8)))
+	return b
+
+def hammingEncode (d):
+	""" extended Hamming(8,4), data in bits 0…3, parity in 4…7 """
+	b = [(d >> i) & 1 for i in range (4)]
+	p1 = b[0] ^ b[1] ^ b[3]
+	p2 = b[0] ^ b[2] ^ b[3]
+	p3 = b[1] ^ b[2] ^ b[3]
+	c = d | p1 << 4 | p2 << 5 | p3 << 6
+	p0 = bin (c).count ('1') & 1
+	return c | p0 << 7
+
+def hammingDecode ():
+	""" data in bits 0…3, bit 4 set if corrected, bit 5 if uncorrectable """
+	codes = [hammingEncode (d) for d in range (16)]
+	t = []
+	for r in range (256):
+		dist = [bin (r ^ c).count ('1') for c in codes]
+		best = min (dist)
+		if best == 0:
+			t.append (dist.index (0))
+		elif best == 1:
+			t.append (dist.index (1) | 0x10)
+		else:
+			t.append ((r & 0xf) | 0x20)
+	return t
+
+def dump (f, name, ctype, tables, digits):
+	f.write (f'const {ctype} {name}[4][256] = {{\n')
+	for t in tables:
+		f.write ('\t{\n')
+		for i in range (0, 256, 8):
+			f.write ('\t\t' + ', '.join (f'0x{v:0{digits}x}' for v in t[i:i+8]) + ',\n')
+		f.write ('\t},\n')
+	f.write ('};\n\n')
+
+def dumpBytes (f, name, values):
+	f.write (f'const uint8_t {name}[{len (values)}] = {{\n')
+	for i in range (0, len (values), 12):
+		f.write ('\t' + ', '.join (f'0x{v:02x}' for v in values[i:i+12]) + ',\n')
+	f.write ('};\n')
+
+def main ():
+	f = sys.stdout
+	# same license header as the rest
+	header = os.path.join (os.path.dirname (__file__), '..', 'src', 'tda5340_frame.h')
+	with open (header) as fd:
+		lic = fd.read ()
+	f.write (lic[:lic.index ('*/')+2] + '\n\n')
+	f.write ('/* generated by tools/tda5340frametab.py, do not edit */\n\n')
+	f.write ('#include "tda5340_frame.h"\n\n')
+	f.write ('/* CRC-16/X-25, reflected 0x8408 */\n')
+	dump (f, 'tda5340Crc16Tab', 'uint16_t', crcTable (0x8408, 16), 4)
+	f.write ('/* CRC-32 (IEEE 802.3), reflected 0xedb88320 */\n')
+	dump (f, 'tda5340Crc32Tab', 'uint32_t', crcTable (0xedb88320, 32), 8)
+	f.write ('/* PN9 sequence, lsb first, one period (511 bits) plus 33 bits, so\n')
+	f.write (' * any 32 bit window can be read with a 40 bit load */\n')
+	seq = pn9 (8*68)
+	dumpBytes (f, 'tda5340Pn9Tab', seq)
+	f.write ('\n/* extended Hamming(8,4) codewords, data in bits 0…3 */\n')
+	dumpBytes (f, 'tda5340HammingEncTab', [hammingEncode (d) for d in range (16)])
+	f.write ('\n/* Hamming decoder, data in bits 0…3, bit 4 set if an error was\n')
+	f.write (' * corrected, bit 5 if it was uncorrectable */\n')
+	dumpBytes (f, 'tda5340HammingDecTab', hammingDecode ())
+
+if __name__ == '__main__':
+	main ()
@@ -0,0 +1,154 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* Two tda5340Link back to back on a host, connected by a simulated radio
+ * with latency and frame loss. Link 0 sends numbered payloads, link 1 checks
+ * they arrive in order. Prints statistics, exits with 1 on reordered or lost
+ * payloads (frames given up on are fine) or if the links stall.
+ *
+ * Build and run from the top level directory:
+ *
+ *	cc -O2 -Isrc -o linksim tools/tda5340linksim.c src/tda5340_link.c \
+ *		src/tda5340_frame.c src/tda5340_frame_tab.c src/tda5340_fec.c
+ *	./linksim [loss percent] [retries] [frames]
+ *
+ * ./linksim 100 0 1000 exercises giving up across sequence number wraps. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tda5340_link.h"
+
+/* one way latency and simulation step in μs */
+#define LATENCY 2000
+#define STEP 100
+#define QUEUE_LEN 256
+#define DEADLINE 1000000000
+
+typedef struct {
+	uint8_t to;
+	uint8_t data[TDA_LINK_FRAME_SIZE];
+	size_t bits;
+	uint32_t at;
+} message;
+
+static uint32_t now;
+static message queue[QUEUE_LEN];
+static size_t queued;
+static tda5340Link links[2];
+static int loss;
+static uint8_t expected;
+static unsigned int delivered, reordered, givenUp;
+
+static uint32_t clock (void) {
+	return now;
+}
+
+static bool transmit (tda5340Link * const link, const uint8_t * const data,
+		const size_t bits) {
+	if (queued >= QUEUE_LEN) {
+		return false;
+	}
+	if (rand () % 100 < loss) {
+		/* lost on air */
+		return true;
+	}
+	message * const m = &queue[queued++];
+	m->to = link == &links[0] ? 1 : 0;
+	memcpy (m->data, data, (bits+7)/8);
+	m->bits = bits;
+	m->at = now + LATENCY;
+	return true;
+}
+
+static void deliver (tda5340Link * const link, const uint8_t * const data,
+		const uint8_t len) {
+	/* payloads that were given up on are skipped */
+	if ((uint8_t) (data[0] - expected) >= 128) {
+		reordered++;
+	}
+	expected = data[0] + 1;
+	delivered++;
+}
+
+static void failed (tda5340Link * const link, const uint8_t seq) {
+	givenUp++;
+}
+
+int main (int argc, char **argv) {
+	loss = argc > 1 ? atoi (argv[1]) : 20;
+	const uint8_t retries = argc > 2 ? atoi (argv[2]) : 10;
+	const unsigned int frames = argc > 3 ? atoi (argv[3]) : 2000;
+	srand (1);
+
+	/* the TDA strips the preamble, so does the simulated radio */
+	static const uint8_t header[] = {0xaa};
+	const tda5340Frame frame = {.header = header, .headerLen = sizeof (header),
+			.crc = TDA_FRAME_CRC16, .whiten = true};
+	for (uint8_t i = 0; i < 2; i++) {
+		links[i] = (tda5340Link) {.frame = &frame, .addr = i, .peer = !i,
+				.window = 4, .retries = retries, .rtoMin = 3*LATENCY,
+				.rtoMax = 50*LATENCY, .send = transmit, .now = clock,
+				.deliver = deliver, .failed = failed};
+		tda5340LinkInit (&links[i]);
+	}
+
+	unsigned int sent = 0;
+	for (now = 0; now < DEADLINE; now += STEP) {
+		if (sent < frames) {
+			uint8_t payload[TDA_LINK_MTU];
+			memset (payload, sent, sizeof (payload));
+			if (tda5340LinkSend (&links[0], payload, sizeof (payload))) {
+				sent++;
+			}
+		}
+		for (size_t i = 0; i < queued;) {
+			if ((int32_t) (now - queue[i].at) >= 0) {
+				const message m = queue[i];
+				queue[i] = queue[--queued];
+				tda5340LinkReceive (&links[m.to], (uint8_t *) m.data +
+						sizeof (header), m.bits - 8*sizeof (header));
+			} else {
+				i++;
+			}
+		}
+		const bool idle = tda5340LinkPoll (&links[0]) == UINT32_MAX;
+		tda5340LinkPoll (&links[1]);
+		if (sent == frames && idle && queued == 0) {
+			break;
+		}
+	}
+
+	const tda5340LinkStats * const s = &links[0].stats, * const r = &links[1].stats;
+	printf ("%u μs, sent %u, delivered %u, given up %u, reordered %u\n", now,
+			sent, delivered, givenUp, reordered);
+	printf ("tx %u, retransmissions %u, timeouts %u, nacks %u, acked %u, "
+			"goodput %u B/s\n", s->txFrames, s->retransmissions, s->timeouts,
+			s->nacksReceived, s->ackedFrames,
+			(unsigned int) ((uint64_t) s->ackedBytes * 1000000 / (now + 1)));
+	printf ("rx %u, duplicates %u, bad %u, nacks %u\n", r->rxFrames,
+			r->duplicates, r->badFrames, r->nacksSent);
+
+	const bool stalled = now >= DEADLINE;
+	return reordered > 0 || delivered + givenUp < sent || stalled;
+}
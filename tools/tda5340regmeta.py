@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+"""
+Generate the register attribute table from the address definitions.
+
+Usage: tda5340regmeta.py > src/tda5340_reg.c
+"""
+
+import os, re, sys
+
+# configuration registers of config A, the other pages have the same layout
+CONFIG = re.compile (r'^A_')
+# first read-only status register, mirrored registers below are configuration
+STATUS_FIRST = 'PLLSTAT'
+# mirrored registers that are neither configuration nor plain status
+SPECIAL = {
+	'SFRPAGE': 'TDA_REG_VALID | TDA_REG_MIRROR | TDA_REG_READ | TDA_REG_WRITE',
+	# command registers, bits clear themselves
+	'EXTPCMD': 'TDA_REG_VALID | TDA_REG_MIRROR | TDA_REG_WRITE | TDA_REG_VOLATILE',
+	'TXC': 'CMD',
+	'RXC': 'CMD',
+	# write-only
+	'CMC': 'TDA_REG_VALID | TDA_REG_MIRROR | TDA_REG_WRITE',
+	'IS0': 'STATUS | TDA_REG_CLEARONREAD',
+	'IS1': 'STATUS | TDA_REG_CLEARONREAD',
+	'IS2': 'STATUS | TDA_REG_CLEARONREAD',
+	# constant
+	'SN0': 'CONST',
+	'SN1': 'CONST',
+	'SN2': 'CONST',
+	'SN3': 'CONST',
+	'CHIPID': 'CONST',
+	}
+
+def registers (path):
+	""" (address, name) of page A and mirrored registers, by address """
+	regs = []
+	with open (path) as fd:
+		for l in fd:
+			m = re.match (r'#define TDA_(\w+)\t0x([0-9A-Fa-f]+)$', l)
+			if m and int (m.group (2), 16) < 0x100:
+				regs.append ((int (m.group (2), 16), m.group (1)))
+	return sorted (regs)
+
+def attributes (regs):
+	statusFirst = dict ((n, a) for a, n in regs)[STATUS_FIRST]
+	out = []
+	for address, name in regs:
+		if address < 0xa0:
+			assert CONFIG.match (name), name
+			attr = 'CFG'
+		elif name in SPECIAL:
+			attr = SPECIAL[name]
+		elif address >= statusFirst:
+			attr = 'STATUS'
+		else:
+			attr = 'MCFG'
+		out.append ((address, name, attr))
+	return out
+
+def main ():
+	f = sys.stdout
+	src = os.path.join (os.path.dirname (__file__), '..', 'src')
+	# same license header as the rest
+	with open (os.path.join (src, 'tda5340_reg.h')) as fd:
+		lic = fd.read ()
+	f.write (lic[:lic.index ('*/')+2] + '\n\n')
+	f.write ('/* generated by tools/tda5340regmeta.py, do not edit */\n\n')
+	f.write ('#include "tda5340_reg.h"\n\n')
+	f.write ('/* common attributes */\n')
+	f.write ('#define CFG (TDA_REG_VALID | TDA_REG_READ | TDA_REG_WRITE | TDA_REG_CONFIG)\n')
+	f.write ('#define MCFG (CFG | TDA_REG_MIRROR)\n')
+	f.write ('#define STATUS (TDA_REG_VALID | TDA_REG_MIRROR | TDA_REG_READ | TDA_REG_VOLATILE)\n')
+	f.write ('#define CMD (TDA_REG_VALID | TDA_REG_MIRROR | TDA_REG_READ | TDA_REG_WRITE | \\\n')
+	f.write ('\t\tTDA_REG_VOLATILE)\n')
+	f.write ('#define CONST (TDA_REG_VALID | TDA_REG_MIRROR | TDA_REG_READ)\n\n')
+	f.write ('/* Register attributes, indexed by the address’ low byte. Configuration\n')
+	f.write (' * registers 0x00…0x84 exist once per page (config A…D), everything from\n')
+	f.write (' * 0xa0 upwards is mirrored on all pages. Gaps are invalid. */\n')
+	f.write ('const uint8_t tda5340RegMeta[256] = {\n')
+	attrs = attributes (registers (os.path.join (src, 'tda5340_reg.h')))
+	for address, name, attr in attrs:
+		f.write (f'\t[TDA_{name}] = {attr},\n')
+	f.write ('\t};\n\n')
+	# snapshot sizes depend on these
+	config = [a for a, n, attr in attrs if attr in ('CFG', 'MCFG')]
+	paged = len ([a for a in config if a < 0xa0])
+	mirrored = len (config) - paged
+	f.write (f'_Static_assert (TDA_REG_CONFIG_PAGED == 0x{paged:x}, "paged config");\n')
+	f.write (f'_Static_assert (TDA_REG_CONFIG_MIRRORED == {mirrored}, "mirrored config");\n')
+
+if __name__ == '__main__':
+	main ()
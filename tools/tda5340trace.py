@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+"""
+Decode a libprettylewis binary event trace (tda5340TraceEvent records, as
+returned by tda5340TraceRead and dumped verbatim, little endian) into a
+timeline and latency statistics.
+
+Usage: tda5340trace.py dump.bin
+"""
+
+import struct, sys
+from collections import defaultdict
+
+EVENT = struct.Struct ('<IBBH')
+
+SPI_BEGIN, SPI_END, IRQ_ENTER, IRQ_EXIT, MODE, RETRY, OVERFLOW, RESET_FAIL, \
+		PHISHY = range (1, 10)
+
+COMMANDS = {0x2: 'WR', 0x3: 'RD', 0x4: 'RDF', 0x6: 'WRF'}
+MODES = {0: 'sleep', 1: 'self polling', 2: 'run', 3: 'transmit', 4: 'reset'}
+
+def describe (type, a, b):
+	if type == SPI_BEGIN:
+		return 'spi {} 0x{:03x}'.format (COMMANDS.get (a, hex (a)), b)
+	elif type == SPI_END:
+		return 'spi end'
+	elif type == IRQ_ENTER:
+		return 'irq enter, {}'.format (MODES.get (a, a))
+	elif type == IRQ_EXIT:
+		return 'irq exit, {}, IS0 {:02x} IS2 {:02x}'.format (MODES.get (a, a),
+				b >> 8, b & 0xff)
+	elif type == MODE:
+		return 'mode {}, config {}'.format (MODES.get (a, a), 'ABCD'[b & 3])
+	elif type == RETRY:
+		return 'write retry 0x{:03x}, {} left'.format (b, a)
+	elif type == OVERFLOW:
+		return 'rx fifo overflow'
+	elif type == RESET_FAIL:
+		return 'reset failed, IS0 {:02x} IS1 {:02x} IS2 {:02x}'.format (b >> 8,
+				b & 0xff, a)
+	elif type == PHISHY:
+		return 'phishy status'
+	return 'unknown event {} {} {}'.format (type, a, b)
+
+def stats (name, values):
+	if not values:
+		return
+	values = sorted (values)
+	print ('{}: n={} min={} median={} max={} μs'.format (name, len (values),
+			values[0], values[len (values)//2], values[-1]))
+
+def main ():
+	data = open (sys.argv[1], 'rb').read ()
+	start = None
+	spiStart = None
+	irqStart = None
+	durations = defaultdict (list)
+
+	for time, type, a, b in EVENT.iter_unpack (data[:len (data)//EVENT.size*EVENT.size]):
+		if start is None:
+			start = time
+		# clock wraps at 32 bit
+		print ('{:10d} {}'.format ((time - start) & 0xffffffff, describe (type, a, b)))
+
+		if type == SPI_BEGIN:
+			spiStart = (time, COMMANDS.get (a, hex (a)))
+		elif type == SPI_END and spiStart:
+			durations['spi ' + spiStart[1]].append ((time - spiStart[0]) & 0xffffffff)
+			spiStart = None
+		elif type == IRQ_ENTER:
+			irqStart = time
+		elif type == IRQ_EXIT and irqStart is not None:
+			durations['irq'].append ((time - irqStart) & 0xffffffff)
+			irqStart = None
+
+	print ()
+	for k, v in sorted (durations.items ()):
+		stats (k, v)
+
+if __name__ == '__main__':
+	main ()